@@ -3,179 +3,277 @@
 #include <sstream>
 #include <cctype>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <locale>
 #include <limits>
 #include <iostream>
 
 using std::cout;
 using std::endl;
 
-Atom::Atom(): m_type(NoneKind) {}
+Atom::Atom(): rawValue(0), m_tag(tag(NoneKind)) {}
 
-Atom::Atom(double value){
-  setNumber(value);
+Atom::Atom(const Token & token): Atom(){
+
+  std::string text = token.asString();
+  *this = Atom(text.data(), text.size());
 }
 
-Atom::Atom(const Token & token): Atom(){
+// the characters of a token that the stream extraction of a double would
+// consume, and what they hold
+struct NumberScan {
+  std::size_t length;      // characters consumed
+  bool convertible;        // the consumed characters form a complete number
+  bool negative;
+  std::uint64_t mantissa;  // the leading significant digits
+  int digits;              // significant digits in mantissa
+  bool inexact;            // there were more significant digits than fit
+  long exponent;           // decimal exponent applied to mantissa
+};
+
+static const long EXPONENT_LIMIT = 100000;
+
+// scan the longest prefix of text accepted by the C locale num_get facet:
+// an optional sign, digits with at most one decimal point, then, after at
+// least one digit, an exponent with an optional sign
+static NumberScan scan_number(const char * text, std::size_t length){
+
+  NumberScan scan = {0, false, false, 0, 0, false, 0};
+  std::size_t i = 0;
+
+  if(i < length && (text[i] == '+' || text[i] == '-')){
+    scan.negative = (text[i] == '-');
+    ++i;
+  }
 
-  // is token a number?
-  double temp;
-  std::istringstream iss(token.asString());
-  if(iss >> temp){
-    // check for trailing characters if >> succeeds
-    if(iss.rdbuf()->in_avail() == 0){
-      setNumber(temp);
+  bool found_mantissa = false;
+  bool found_point = false;
+  for(; i < length; ++i){
+    char c = text[i];
+    if(c >= '0' && c <= '9'){
+      found_mantissa = true;
+      if(scan.digits == 0 && c == '0'){
+        // leading zeros are not significant
+      }
+      else if(scan.digits < 19){
+        scan.mantissa = scan.mantissa * 10 + static_cast<std::uint64_t>(c - '0');
+        ++scan.digits;
+      }
+      else{
+        scan.inexact = true;
+        continue;
+      }
+      if(found_point){
+        --scan.exponent;
+      }
+    }
+    else if(c == '.' && !found_point){
+      found_point = true;
+    }
+    else{
+      break;
     }
   }
-  else{ // else assume symbol
-    // make sure does not start with number
-    if(!std::isdigit(token.asString()[0])){
-      setSymbol(token.asString());
+
+  if(i < length && found_mantissa && (text[i] == 'e' || text[i] == 'E')){
+    ++i;
+    bool negative_exponent = false;
+    if(i < length && (text[i] == '+' || text[i] == '-')){
+      negative_exponent = (text[i] == '-');
+      ++i;
+    }
+    bool found_exponent = false;
+    long exponent = 0;
+    for(; i < length && text[i] >= '0' && text[i] <= '9'; ++i){
+      found_exponent = true;
+      if(exponent < EXPONENT_LIMIT){
+        exponent = exponent * 10 + (text[i] - '0');
+      }
     }
+    scan.length = i;
+    scan.convertible = found_exponent;
+    scan.exponent += negative_exponent ? -exponent : exponent;
+    return scan;
   }
-}
 
-Atom::Atom(const std::complex<double> & complexValue)
-{
-  setComplex(complexValue);
+  scan.length = i;
+  scan.convertible = found_mantissa;
+  return scan;
 }
 
-Atom::Atom(const std::string & value): Atom(){
-    setSymbol(value);
-}
+// convert a scanned number exactly when the mantissa and a power of ten are
+// both exact doubles, so a single rounding gives the nearest double
+static bool convert_fast(const NumberScan & scan, double & value){
 
-Atom::Atom(const Atom & x): Atom(){
-  if(x.isNumber()){
-    setNumber(x.numberValue);
+  static const double powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const std::uint64_t max_exact = std::uint64_t(1) << 53;
+
+  if(scan.inexact){
+    return false;
+  }
+  if(scan.mantissa == 0){
+    value = 0.0;
+  }
+  else if(scan.mantissa > max_exact || scan.exponent < -22 || scan.exponent > 22){
+    return false;
   }
-  else if(x.isSymbol()){
-    setSymbol(x.stringValue);
+  else if(scan.exponent < 0){
+    value = static_cast<double>(scan.mantissa) / powers[-scan.exponent];
   }
-  else if (x.isComplex())//is complex?
-  {
-    setComplex(x.complexNum);
+  else{
+    value = static_cast<double>(scan.mantissa) * powers[scan.exponent];
   }
-  else if (x.isList())
-  {
-    setList();
+  if(scan.negative){
+    value = -value;
   }
+  return true;
 }
 
-Atom & Atom::operator=(const Atom & x){
+// convert the first length characters of text, already known to form a
+// complete number, independently of the global locale
+static double convert_slow(const char * text, std::size_t length){
 
-  if(this != &x){
-    if(x.m_type == NoneKind){
-      m_type = NoneKind;
-    }
-    else if(x.m_type == NumberKind){
-      setNumber(x.numberValue);
-    }
-    else if(x.m_type == SymbolKind){
-      setSymbol(x.stringValue);
-    }
-    else if(x.m_type == ComplexKind)//if complex
-    {
-      setComplex(x.complexNum);
-    }
-    else if(x.m_type == ListKind)
-    {
-      setList();
+  std::istringstream iss(std::string(text, length));
+  iss.imbue(std::locale::classic());
+  double value = std::numeric_limits<double>::infinity();
+  // extraction fails only when the value is out of range
+  iss >> value;
+  return iss.fail() ? std::numeric_limits<double>::infinity() : value;
+}
+
+Atom::Atom(const char * text, std::size_t length): Atom(){
+
+  // a number starts with a digit, a sign or a decimal point, anything else
+  // is a symbol
+  char c = (length > 0) ? text[0] : '\0';
+  bool leading_digit = std::isdigit(static_cast<unsigned char>(c)) != 0;
+  if(!leading_digit && (c != '+') && (c != '-') && (c != '.')){
+    setSymbol(std::string(text, length));
+    return;
+  }
+
+  // is token a number? A token that is not, or whose value is out of range,
+  // is a symbol unless it starts with a digit. A number followed by other
+  // characters is neither.
+  NumberScan scan = scan_number(text, length);
+  double value = 0;
+  if(scan.convertible && !convert_fast(scan, value)){
+    value = convert_slow(text, scan.length);
+  }
+
+  if(!scan.convertible || std::isinf(value)){
+    if(!leading_digit){
+      setSymbol(std::string(text, length));
     }
   }
-  return *this;
+  else if(scan.length == length){
+    setNumber(value);
+  }
 }
 
-Atom::~Atom(){
+Atom::Atom(const std::complex<double> & complexValue)
+{
+  setComplex(complexValue);
+}
 
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
-  }
+Atom::Atom(const std::string & value): Atom(){
+    setSymbol(value);
 }
 
-bool Atom::isNone() const noexcept{
-  return m_type == NoneKind;
+// every value kind is held by value in two words, so copies and moves
+// are plain word copies
+Atom::Type Atom::type() const noexcept{
+
+  // anything that is not a tag is the imaginary part of a Complex
+  if((m_tag & TAG_BASE) != TAG_BASE){
+    return ComplexKind;
+  }
+  return static_cast<Type>(m_tag & ~TAG_BASE);
 }
 
-bool Atom::isNumber() const noexcept{
-  return m_type == NumberKind;
+bool Atom::isNone() const noexcept{
+  return m_tag == tag(NoneKind);
 }
 
 bool Atom::isSymbol() const noexcept{
-  return m_type == SymbolKind;
+  return m_tag == tag(SymbolKind);
 }
 
 bool Atom::isComplex() const noexcept{
-  return m_type == ComplexKind;//return if type is complex
-}
-
-bool Atom::isList() const noexcept{
-  return m_type == ListKind;//return if type is list
+  return type() == ComplexKind;//return if type is complex
 }
 
 void Atom::setNumber(double value){
 
-  m_type = NumberKind;
+  m_tag = tag(NumberKind);
   numberValue = value;
 }
 
 void Atom::setSymbol(const std::string & value){
 
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
-  }
-    m_type = SymbolKind;
-
-    // copy construct in place
-    new (&stringValue) std::string(value);
+  rawValue = 0;
+  m_tag = tag(SymbolKind);
+  symbolValue = SymbolTable::intern(value);
 }
 
 void Atom::setComplex(const std::complex<double> & complex){
 
-  // we need to ensure the destructor of the symbol string is called
-  m_type = ComplexKind;//setting complex
-  complexNum = complex;
-  // copy construct in place
-  //TODO - maybe copy constructor?????
+  numberValue = complex.real();
+
+  // store the imaginary part in the tag word, NaNs in canonical form
+  double imag = complex.imag();
+  std::uint64_t bits;
+  std::memcpy(&bits, &imag, sizeof(bits));
+  m_tag = std::isnan(imag) ? 0x7FF8000000000000ull : bits;
 }
 
 void Atom::setList(){
-  m_type = ListKind;//setting list kind for the m_type
+  rawValue = 0;
+  m_tag = tag(ListKind);//setting list kind for the tag
 }
 
-double Atom::asNumber() const noexcept{
 
-  return (m_type == NumberKind) ? numberValue : 0.0;
-}
+const std::string & Atom::asSymbol() const noexcept{
 
+  static const std::string empty;
 
-std::string Atom::asSymbol() const noexcept{
+  if(isSymbol()){
+    return SymbolTable::name(symbolValue);
+  }
 
-  std::string result;
+  return empty;
+}
 
-  if(m_type == SymbolKind){
-    result = stringValue;
-  }
+SymbolTable::IdType Atom::symbolId() const noexcept{
 
-  return result;
+  return symbolValue;
 }
 
 std::complex<double> Atom::asComplex() const noexcept{
 
-  return (m_type == ComplexKind) ? complexNum : std::complex<double>(0.0,1.0);//default value for complex type
+  if(!isComplex()){
+    return std::complex<double>(0.0,1.0);//default value for complex type
+  }
+
+  double imag;
+  std::memcpy(&imag, &m_tag, sizeof(imag));
+  return std::complex<double>(numberValue, imag);
 }
 
 bool Atom::operator==(const Atom & right) const noexcept{
 
-  if(m_type != right.m_type) return false;
+  Type kind = type();
+  if(kind != right.type()) return false;
 
-  switch(m_type){
+  switch(kind){
   case NoneKind:
-    if(right.m_type != NoneKind) return false;
     break;
   case NumberKind:
     {
-      if(right.m_type != NumberKind) return false;
       double dleft = numberValue;
       double dright = right.numberValue;
       double diff = fabs(dleft - dright);
@@ -185,22 +283,16 @@ bool Atom::operator==(const Atom & right) const noexcept{
     break;
   case SymbolKind:
     {
-      if(right.m_type != SymbolKind) return false;
-
-      return stringValue == right.stringValue;
+      return symbolValue == right.symbolValue;
     }
     break;
   case ComplexKind:
     {
-      if(right.m_type != ComplexKind) return false;
-
-      return complexNum == right.complexNum;
+      return asComplex() == right.asComplex();
     }
     break;
   case ListKind:
     {
-      if (right.m_type != ListKind) return false;
-
       return true;
     }
     break;
@@ -5,13 +5,20 @@ Defines the Atom type and associated functions.
 #define ATOM_HPP
 
 #include "token.hpp"
+#include "symbol_table.hpp"
 #include <complex>
-#include <vector>
+#include <cstdint>
 
 /*! \class Atom
 \brief A variant type that may be a Number or Symbol or the default type None.
 
 This class provides value semantics.
+
+An Atom is a 16 byte tagged value. The first word holds a Number, the id
+of an interned Symbol, or the real part of a Complex. The second word holds
+either the imaginary part of a Complex or a NaN-boxed type tag. Imaginary
+parts that are NaN are stored as the canonical quiet NaN, which never
+collides with a tag.
 */
 class Atom {
 public:
@@ -25,19 +32,27 @@ public:
   /// Construct an Atom of type Symbol named value
   Atom(const std::string & value);
 
+  /// Construct an Atom of type Complex with value
   Atom(const std::complex<double> & complexValue);
 
-  Atom(const std::vector<Atom> & listVector);
-
   /// Construct an Atom directly from a Token
   Atom(const Token & token);
 
+  /// Construct an Atom from the length characters of a token starting at text
+  Atom(const char * text, std::size_t length);
+
   /// Copy-construct an Atom
   Atom(const Atom & x);
 
+  /// Move-construct an Atom
+  Atom(Atom && x) noexcept;
+
   /// Assign an Atom
   Atom & operator=(const Atom & x);
 
+  /// Move-assign an Atom
+  Atom & operator=(Atom && x) noexcept;
+
   /// Atom destructor
   ~Atom();
 
@@ -61,15 +76,16 @@ public:
   /// value of Atom as a number, return 0 if not a Number
   double asNumber() const noexcept;
 
-  /// value of Atom as a number, returns empty-string if not a Symbol
-  std::string asSymbol() const noexcept;
+  /// value of Atom as a symbol, returns empty-string if not a Symbol.
+  /// The reference is to the interned name and stays valid.
+  const std::string & asSymbol() const noexcept;
+
+  /// interned id of a Symbol Atom, only meaningful if isSymbol()
+  SymbolTable::IdType symbolId() const noexcept;
 
   /// value of Atom as a number, returns empty-string if not a Symbol
   std::complex<double> asComplex() const noexcept;
 
-  /// value of Atom as a list, returns empty list if not a list
-  std::vector<Atom> asList() const noexcept;
-
   /// equality comparison based on type and value
   bool operator==(const Atom & right) const noexcept;
 
@@ -82,19 +98,24 @@ private:
   // internal enum of known types
   enum Type {NoneKind, NumberKind, SymbolKind, ComplexKind, ListKind, LambdaKind};
 
-  // track the type
-  Type m_type;
+  // tags are negative NaNs with a payload, which no canonical double uses
+  static const std::uint64_t TAG_BASE = 0xFFFF000000000000ull;
 
-  std::vector<Atom> listVec;//create a vector of the Expression
+  static std::uint64_t tag(Type t) noexcept { return TAG_BASE | t; }
 
-  // values for the known types. Note the use of a union requires care
-  // when setting non POD values (see setSymbol)
+  // the type stored in the tag word
+  Type type() const noexcept;
+
+  // values for the known types, or the real part of a Complex
   union {
     double numberValue;
-    std::string stringValue;
-    std::complex<double> complexNum;
+    SymbolTable::IdType symbolValue;
+    std::uint64_t rawValue; // used to copy the word whatever it holds
   };
 
+  // a type tag, or the bits of the imaginary part of a Complex
+  std::uint64_t m_tag;
+
   // helper to set type and value of Number
   void setNumber(double value);
 
@@ -106,6 +127,41 @@ private:
 
 };
 
+// copying an Atom, reading a Number and testing for a List are defined
+// here, so that they inline into the evaluator and the procedures
+
+inline Atom::Atom(double value): numberValue(value), m_tag(tag(NumberKind)){}
+
+inline Atom::Atom(const Atom & x): rawValue(x.rawValue), m_tag(x.m_tag){}
+
+inline Atom::Atom(Atom && x) noexcept: rawValue(x.rawValue), m_tag(x.m_tag){}
+
+inline Atom & Atom::operator=(const Atom & x){
+  rawValue = x.rawValue;
+  m_tag = x.m_tag;
+  return *this;
+}
+
+inline Atom & Atom::operator=(Atom && x) noexcept{
+  rawValue = x.rawValue;
+  m_tag = x.m_tag;
+  return *this;
+}
+
+inline Atom::~Atom(){}
+
+inline bool Atom::isNumber() const noexcept{
+  return m_tag == tag(NumberKind);
+}
+
+inline double Atom::asNumber() const noexcept{
+  return isNumber() ? numberValue : 0.0;
+}
+
+inline bool Atom::isList() const noexcept{
+  return m_tag == tag(ListKind);//return if type is list
+}
+
 /// inequality comparison for Atom
 bool operator!=(const Atom &left, const Atom & right) noexcept;
 
@@ -2,6 +2,9 @@
 
 #include "atom.hpp"
 
+#include <cmath>
+#include <limits>
+
 TEST_CASE( "Test constructors", "[atom]" ) {
 
   {
@@ -226,3 +229,91 @@ TEST_CASE( "test comparison", "[atom]" ) {
   }
 
 }
+
+TEST_CASE( "Test compact complex representation", "[atom]" ) {
+
+  REQUIRE(sizeof(Atom) == 16);
+
+  {
+    INFO("imaginary parts round trip, including special values");
+    double values[] = {0.0, -0.0, 1.5, -2.25, std::numeric_limits<double>::infinity(),
+                       -std::numeric_limits<double>::infinity()};
+    for(double v : values){
+      Atom a(std::complex<double>(3.0, v));
+      REQUIRE(a.isComplex());
+      REQUIRE(!a.isNumber());
+      REQUIRE(a.asComplex().real() == 3.0);
+      REQUIRE(a.asComplex().imag() == v);
+      REQUIRE(std::signbit(a.asComplex().imag()) == std::signbit(v));
+    }
+  }
+
+  {
+    INFO("a NaN imaginary part is still a complex");
+    Atom a(std::complex<double>(1.0, std::numeric_limits<double>::quiet_NaN()));
+    REQUIRE(a.isComplex());
+    REQUIRE(std::isnan(a.asComplex().imag()));
+  }
+
+  {
+    INFO("copies keep the kind");
+    Atom a(std::complex<double>(1.0, 2.0));
+    Atom b = a;
+    Atom c;
+    c = Atom("sym");
+    REQUIRE(b == a);
+    REQUIRE(c.isSymbol());
+    REQUIRE(c.asSymbol() == "sym");
+  }
+}
+
+// convert a token the way the parser does
+static Atom from_token(const std::string & text){
+  return Atom(text.data(), text.size());
+}
+
+TEST_CASE( "Test number tokens", "[atom]" ) {
+
+  {
+    INFO("numbers in every accepted form");
+    REQUIRE(from_token("1").asNumber() == 1);
+    REQUIRE(from_token("-1000.5").asNumber() == -1000.5);
+    REQUIRE(from_token("+2").asNumber() == 2);
+    REQUIRE(from_token(".5").asNumber() == 0.5);
+    REQUIRE(from_token("-.5").asNumber() == -0.5);
+    REQUIRE(from_token("5.").asNumber() == 5);
+    REQUIRE(from_token("00012").asNumber() == 12);
+    REQUIRE(from_token("1E5").asNumber() == 1e5);
+    REQUIRE(from_token("5.e3").asNumber() == 5000);
+    REQUIRE(from_token("-2.5e-3").asNumber() == -2.5e-3);
+    REQUIRE(std::signbit(from_token("-0").asNumber()));
+  }
+
+  {
+    INFO("values round trip exactly");
+    REQUIRE(from_token("0.1").asNumber() == 0.1);
+    REQUIRE(from_token("9007199254740993").asNumber() == 9007199254740992.0);
+    REQUIRE(from_token("1.7976931348623157e308").asNumber() == std::numeric_limits<double>::max());
+    REQUIRE(from_token("4.9e-324").asNumber() == std::numeric_limits<double>::denorm_min());
+    REQUIRE(from_token("123456789012345678901234567890").asNumber() == 1.2345678901234568e29);
+    REQUIRE(from_token("1e-400").asNumber() == 0);
+  }
+
+  {
+    INFO("tokens that are not numbers are symbols");
+    const char * symbols[] = {"+", "-", ".", "+.", "-e", "+-1", "--1", "-1e", "-1e400", "inf", "nan"};
+    for(auto s : symbols){
+      Atom a = from_token(s);
+      REQUIRE(a.isSymbol());
+      REQUIRE(a.asSymbol() == s);
+    }
+  }
+
+  {
+    INFO("tokens with trailing characters, or that start with a digit but are not numbers, are neither");
+    const char * neither[] = {"1e", "1e+", "1.2.3", "1e5.5", "1,5", "0x10", "0x1p3", "2abc", "1e400"};
+    for(auto s : neither){
+      REQUIRE(from_token(s).isNone());
+    }
+  }
+}
@@ -0,0 +1,376 @@
+// Benchmark driver for the interpreter. Each benchmark evaluates a plotscript
+// program and reports wall time and the number of heap allocations made.
+//
+// usage: benchmarks [name]   (runs every benchmark when no name is given)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "environment.hpp"
+#include "interpreter.hpp"
+#include "parse.hpp"
+#include "semantic_error.hpp"
+
+// count every allocation made through the global operator new
+static std::atomic<std::size_t> allocation_count(0);
+
+void * operator new(std::size_t size){
+  ++allocation_count;
+  void * ptr = std::malloc(size == 0 ? 1 : size);
+  if(ptr == nullptr){
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void * ptr) noexcept{
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept{
+  std::free(ptr);
+}
+
+struct Measurement {
+  double seconds;
+  std::size_t allocations;
+};
+
+// time a callable, counting allocations made while it runs
+Measurement measure(const std::function<void()> & body){
+
+  std::size_t start_count = allocation_count;
+  auto start = std::chrono::steady_clock::now();
+
+  body();
+
+  auto stop = std::chrono::steady_clock::now();
+
+  Measurement m;
+  m.seconds = std::chrono::duration<double>(stop - start).count();
+  m.allocations = allocation_count - start_count;
+  return m;
+}
+
+void report(const std::string & name, const Measurement & m){
+  std::cout << std::left << std::setw(40) << name
+            << std::right << std::setw(12) << std::fixed << std::setprecision(3)
+            << m.seconds * 1000.0 << " ms"
+            << std::setw(14) << m.allocations << " allocs" << std::endl;
+}
+
+// parse a program once and evaluate it repeat times in a fresh interpreter
+Measurement run_program(const std::string & program,
+                        Interpreter::Engine engine = Interpreter::TreeWalkEngine,
+                        std::size_t repeat = 1){
+
+  Interpreter interp;
+  interp.setEngine(engine);
+  std::istringstream iss(program);
+  if(!interp.parseStream(iss)){
+    std::cerr << "Failed to parse benchmark program" << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  return measure([&interp, repeat](){
+      for(std::size_t i = 0; i < repeat; ++i){
+        interp.evaluate();
+      }
+    });
+}
+
+void bench_range_map(){
+
+  report("range + map (10k, lambda)",
+         run_program("(begin (define f (lambda (x) (* x 2))) (map f (range 0 9999 1)))"));
+  report("range + map (10k, builtin)",
+         run_program("(map sin (range 0 9999 1))"));
+  report("range + map + map (10k, lambda)",
+         run_program("(begin (define f (lambda (x) (* x 2))) (map f (map f (range 0 9999 1))))"));
+  report("range + join + rest (10k)",
+         run_program("(begin (define a (range 0 9999 1)) (length (rest (join a a))))"));
+}
+
+void bench_broadcast(){
+
+  report("sin over 1M samples (map)",
+         run_program("(map sin (range 0 1 0.000001))"));
+  report("sin over 1M samples (element-wise)",
+         run_program("(sin (range 0 1 0.000001))"));
+  report("2x + 1 over 1M samples (element-wise)",
+         run_program("(+ (* 2 (range 0 1 0.000001)) 1)"));
+}
+
+void bench_engines(){
+
+  // nested calls of a small lambda, so call overhead dominates
+  std::string calls = "(x)";
+  for(int i = 0; i < 50; ++i){
+    calls = "(f " + calls + ")";
+  }
+  calls.replace(calls.find("(x)"), 3, "x");
+  std::string program = "(begin (define x 1) (define f (lambda (y) (+ (* y 0.5) (- y 1)))) " + calls + ")";
+
+  report("nested lambda x1000 (tree-walk)",
+         run_program(program, Interpreter::TreeWalkEngine, 1000));
+  report("nested lambda x1000 (bytecode)",
+         run_program(program, Interpreter::BytecodeEngine, 1000));
+
+  std::string arithmetic = "(+ (* 2 (- 7 3) (/ 9 3)) (sqrt (^ 2 10)) (* (+ 1 2 3) (- 10 4)))";
+  report("arithmetic x100000 (tree-walk)",
+         run_program(arithmetic, Interpreter::TreeWalkEngine, 100000));
+  report("arithmetic x100000 (bytecode)",
+         run_program(arithmetic, Interpreter::BytecodeEngine, 100000));
+}
+
+void bench_builtin_calls(){
+
+  // call a built-in directly, as the evaluator does from a call site
+  Environment env;
+  Procedure add = env.get_proc(Atom("+"));
+  std::vector<Expression> stack = {Expression(1), Expression(2)};
+  const std::size_t calls = 10000000;
+
+  double sum = 0;
+  Measurement m = measure([&](){
+      for(std::size_t i = 0; i < calls; ++i){
+        sum += add(ArgSpan(stack.data(), stack.size())).head().asNumber();
+      }
+    });
+  report("binary + x10M (direct)", m);
+  std::cout << std::setw(40) << "" << std::setw(12) << std::setprecision(1)
+            << calls / m.seconds / 1e6 << " M calls/s" << std::endl;
+  if(sum == 0){
+    std::cout << "no calls made" << std::endl;
+  }
+
+  // and through the tree-walker, one binary call per element
+  std::string program = "(begin (define f (lambda (x) (+ x 1))) (map f (range 0 99999 1)))";
+  m = run_program(program, Interpreter::TreeWalkEngine, 10);
+  report("binary + in map x1M (tree-walk)", m);
+  std::cout << std::setw(40) << "" << std::setw(12) << std::setprecision(1)
+            << 1e6 / m.seconds / 1e6 << " M calls/s" << std::endl;
+}
+
+void bench_lambda_calls(){
+
+  // the same calls with a small and a large global environment
+  std::string program = "(begin (define f (lambda (x) (* x 2))) (map f (range 0 9999 1)))";
+  std::string globals = "(begin ";
+  for(int i = 0; i < 1000; ++i){
+    globals += "(define g" + std::to_string(i) + " (list 1 2 3)) ";
+  }
+
+  report("map lambda (10k, 0 globals)", run_program(program));
+  report("map lambda (10k, 1000 globals)",
+         run_program(globals + program.substr(7)));
+}
+
+void bench_tail_calls(){
+
+  // the language has no conditionals, so the loop ends when ln is called
+  // with a negative argument after 1M iterations
+  std::string program = "(begin (define loop (lambda (n) (begin (ln n) (loop (- n 1))))) (loop 999999))";
+
+  for(auto engine : {Interpreter::TreeWalkEngine, Interpreter::BytecodeEngine}){
+    Interpreter interp;
+    interp.setEngine(engine);
+    std::istringstream iss(program);
+    interp.parseStream(iss);
+
+    report(engine == Interpreter::TreeWalkEngine ? "tail loop 1M (tree-walk)" : "tail loop 1M (bytecode)",
+           measure([&interp](){
+               try{
+                 interp.evaluate();
+               }
+               catch(const SemanticError &){
+               }
+             }));
+  }
+}
+
+void bench_plots(){
+
+  report("discrete-plot (1000 points)",
+         run_program("(begin (define f (lambda (x) (list x (sin x)))) (discrete-plot (map f (range 0 999 1)) (list (list \"title\" \"Sine\"))))"));
+  report("continuous-plot",
+         run_program("(begin (define f (lambda (x) (sin x))) (continuous-plot f (list (- pi) pi)))"));
+}
+
+void bench_accessors(){
+
+  report("string literal lookups (10k)",
+         run_program("(begin (define f (lambda (x) \"a string literal longer than the small buffer\")) (map f (range 0 9999 1)))"));
+
+  // walk a plot the way the notebook renders it
+  Interpreter interp;
+  std::istringstream iss("(begin (define f (lambda (x) (list x (sin x)))) (discrete-plot (map f (range 0 999 1)) (list (list \"title\" \"Sine\"))))");
+  interp.parseStream(iss);
+  Expression plot = interp.evaluate();
+
+  double sum = 0;
+  report("render traversal x100 (1000 points)", measure([&plot, &sum](){
+        for(int i = 0; i < 100; ++i){
+          for(auto it = plot.tailConstBegin(); it != plot.tailConstEnd(); ++it){
+            if(it->getPropSize() == 0){
+              continue;
+            }
+            const std::string & name = it->searchMap().head().asSymbol();
+            if(name == "\"point\""){
+              sum += it->getTail(0).head().asNumber() + it->handleMakePoint().head().asNumber();
+            }
+            else if(name == "\"line\""){
+              sum += it->getTail(0).getTail(1).head().asNumber() + it->getTail(1).getTail(0).head().asNumber();
+            }
+            else{
+              sum += it->handleMakeText().getTail(0).head().asNumber() + it->head().asSymbol().size();
+            }
+          }
+        }
+      }));
+  if(sum == 0){
+    std::cout << "empty traversal" << std::endl;
+  }
+}
+
+// a data script: one list literal of count numbers
+static std::string list_literal(std::size_t count){
+
+  std::ostringstream out;
+  out << "(list";
+  for(std::size_t i = 0; i < count; ++i){
+    out << " " << (i * 0.25 - 1000.5);
+  }
+  out << ")";
+  return out.str();
+}
+
+void bench_load(){
+
+  std::string script = list_literal(200000);
+
+  report("tokenize 200k numbers (stream)", measure([&script](){
+        std::istringstream iss(script);
+        tokenize(iss);
+      }));
+  report("tokenize 200k numbers (buffer)", measure([&script](){
+        std::istringstream iss(script);
+        SourceBuffer source(iss);
+        tokenize(source);
+      }));
+  report("parse 200k numbers (stream)", measure([&script](){
+        std::istringstream iss(script);
+        parse(tokenize(iss));
+      }));
+  report("parse 200k numbers (buffer)", measure([&script](){
+        std::istringstream iss(script);
+        SourceBuffer source(iss);
+        parse(source, tokenize(source));
+      }));
+  report("parse 200k numbers (fused)", measure([&script](){
+        std::istringstream iss(script);
+        SourceBuffer source(iss);
+        parse(source);
+      }));
+
+  // the same shape with symbols, which convert quickly, to show the cost
+  // of the parse itself
+  std::string symbols = "(list";
+  for(std::size_t i = 0; i < 200000; ++i){
+    symbols += " s";
+  }
+  symbols += ")";
+  report("parse 200k symbols (stream)", measure([&symbols](){
+        std::istringstream iss(symbols);
+        parse(tokenize(iss));
+      }));
+  report("parse 200k symbols (buffer)", measure([&symbols](){
+        std::istringstream iss(symbols);
+        SourceBuffer source(iss);
+        parse(source, tokenize(source));
+      }));
+  report("parse 200k symbols (fused)", measure([&symbols](){
+        std::istringstream iss(symbols);
+        SourceBuffer source(iss);
+        parse(source);
+      }));
+
+  // converting numeric tokens dominates loading a large data file
+  std::string million = list_literal(1000000);
+  report("parse 1M numbers (fused)", measure([&million](){
+        std::istringstream iss(million);
+        SourceBuffer source(iss);
+        parse(source);
+      }));
+
+  // the same program fed to the streaming parser a block at a time
+  report("parse 1M numbers (64k blocks)", measure([&million](){
+        StreamParser parser;
+        const std::size_t block = 1 << 16;
+        for(std::size_t offset = 0; offset < million.size(); offset += block){
+          parser.feed(million.data() + offset, std::min(block, million.size() - offset));
+        }
+        parser.finish();
+        Expression exp;
+        parser.next(exp);
+      }));
+}
+
+void bench_parallel_load(){
+
+  std::string million = list_literal(1000000);
+  std::istringstream iss(million);
+  SourceBuffer source(iss);
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << "hardware threads: " << cores << std::endl;
+
+  // the atoms of the literal are made in parallel, the rest of the parse
+  // is serial
+  for(unsigned threads = 1; threads <= std::max(4u, cores); threads *= 2){
+    report("parse 1M numbers, " + std::to_string(threads) + " thread(s)", measure([&source, threads](){
+          parse(source, threads);
+        }));
+  }
+}
+
+struct Benchmark {
+  std::string name;
+  void (*run)();
+};
+
+int main(int argc, char *argv[]){
+
+  std::vector<Benchmark> benchmarks = {
+    {"range-map", bench_range_map},
+    {"broadcast", bench_broadcast},
+    {"engines", bench_engines},
+    {"builtin-calls", bench_builtin_calls},
+    {"lambda-calls", bench_lambda_calls},
+    {"tail-calls", bench_tail_calls},
+    {"plots", bench_plots},
+    {"accessors", bench_accessors},
+    {"load", bench_load},
+    {"parallel-load", bench_parallel_load},
+  };
+
+  std::string selected = (argc == 2) ? argv[1] : "";
+
+  for(auto & b : benchmarks){
+    if(selected.empty() || selected == b.name){
+      b.run();
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
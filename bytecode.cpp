@@ -0,0 +1,283 @@
+#include "bytecode.hpp"
+
+// system includes
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+// module includes
+#include "semantic_error.hpp"
+
+/***********************************************************************
+Compiler
+**********************************************************************/
+
+Bytecode Bytecode::compile(const Expression & exp, Environment & env){
+
+  Bytecode program;
+  program.emit(exp, env);
+  program.code.push_back({RETURN, 0, 0});
+  return program;
+}
+
+std::uint32_t Bytecode::constant(const Expression & exp){
+
+  constants.push_back(exp);
+  return static_cast<std::uint32_t>(constants.size() - 1);
+}
+
+// predicate, a special-form is well formed enough to compile. Anything else
+// is left to the tree-walker, which raises the appropriate error when the
+// form is evaluated.
+static bool compilable(const Expression & exp){
+
+  switch(exp.form()){
+  case Expression::BeginForm:
+    return exp.getTail(0).isHeadSymbol();
+  case Expression::DefineForm:
+    {
+      if(exp.tailSize() != 2 || !exp.getTail(0).isHeadSymbol()){
+        return false;
+      }
+      Expression::Form f = exp.getTail(0).form();
+      return (f != Expression::DefineForm) && (f != Expression::BeginForm) && (f != Expression::ApplyForm);
+    }
+  case Expression::LambdaForm:
+    return (exp.tailSize() == 2) && exp.getTail(0).isHeadSymbol();
+  case Expression::CallForm:
+  case Expression::ListForm:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void Bytecode::emit(const Expression & exp, Environment & env){
+
+  // leaves are literals or symbol lookups
+  if(exp.tailSize() == 0){
+    if(exp.isHeadNumber() || exp.isHeadComplex()){
+      code.push_back({PUSH, constant(exp), 0});
+    }
+    else if(exp.form() == Expression::ListForm){
+      code.push_back({PUSH, constant(Expression(std::vector<Expression>())), 0});
+    }
+    else{
+      code.push_back({LOAD, constant(exp), 0});
+    }
+    return;
+  }
+
+  if(!compilable(exp)){
+    code.push_back({EVAL, constant(exp), 0});
+    return;
+  }
+
+  switch(exp.form()){
+  case Expression::BeginForm:
+    for(auto it = exp.tailConstBegin(); it != exp.tailConstEnd(); ++it){
+      if(it != exp.tailConstBegin()){
+        code.push_back({POP, 0, 0});
+      }
+      emit(*it, env);
+    }
+    break;
+  case Expression::DefineForm:
+    emit(exp.getTail(1), env);
+    code.push_back({DEFINE, constant(exp.getTail(0)), 0});
+    break;
+  case Expression::LambdaForm:
+    // building a lambda does not depend on the environment
+    code.push_back({PUSH, constant(exp.eval(env)), 0});
+    break;
+  default:
+    {
+      for(auto it = exp.tailConstBegin(); it != exp.tailConstEnd(); ++it){
+        emit(*it, env);
+      }
+      std::uint32_t argc = static_cast<std::uint32_t>(exp.tailSize());
+
+      // built-ins are resolved now, lambdas and unknown names when called
+      if(env.is_proc(exp.head())){
+        procedures.push_back({exp.head(), env.get_proc(exp.head())});
+        code.push_back({CALL_BUILTIN, static_cast<std::uint32_t>(procedures.size() - 1), argc});
+      }
+      else{
+        code.push_back({CALL, constant(Expression(exp.head())), argc});
+      }
+    }
+  }
+}
+
+/***********************************************************************
+Virtual Machine
+**********************************************************************/
+
+// predicate, value has the shape built by the lambda special-form
+static bool is_lambda(const Expression & value){
+  return value.isHeadList() && (value.tailSize() == 2) &&
+    value.getTail(0).isHeadList() && !value.getTail(1).isHeadList();
+}
+
+// the compiled lambda bodies alive
+static std::atomic<std::size_t> compiled_lambdas(0);
+
+const Bytecode & VirtualMachine::body_of(const Expression & lambda, Environment & env){
+
+  // the tail of a lambda is shared by all of its copies, so the body is
+  // compiled once per lambda and freed with its last copy
+  const ExpressionTail & tail = *lambda.sharedTail();
+  std::call_once(tail.compiled, [&tail, &lambda, &env](){
+    tail.code.reset(new Bytecode(Bytecode::compile(lambda.getTail(1), env)), [](const Bytecode * body){
+        --compiled_lambdas;
+        delete body;
+      });
+    ++compiled_lambdas;
+  });
+  return *tail.code;
+}
+
+void * VirtualMachine::Activation::operator new(std::size_t size){
+  return PoolAllocator<Activation>().allocate(size / sizeof(Activation));
+}
+
+void VirtualMachine::Activation::operator delete(void * p){
+  PoolAllocator<Activation>().deallocate(static_cast<Activation *>(p), 1);
+}
+
+void VirtualMachine::call(const Atom & op, std::uint32_t argc){
+
+  Frame & caller = frames.back();
+
+  args.assign(std::make_move_iterator(stack.end() - argc), std::make_move_iterator(stack.end()));
+  stack.resize(stack.size() - argc);
+
+  // anything but a well formed lambda is handled exactly as the tree-walker does
+  if(!caller.env->is_exp(op)){
+    stack.push_back(apply(op, args, *caller.env));
+    return;
+  }
+
+  Expression value = caller.env->get_exp(op);
+  if(!is_lambda(value)){
+    stack.push_back(apply(op, args, *caller.env));
+    return;
+  }
+
+  const Expression & params = value.getTail(0);
+  if(static_cast<std::size_t>(params.tailSize()) != args.size()){
+    throw SemanticError("Error during evaluation: arguments do not match up with args");
+  }
+
+  // a call in tail position of a lambda body rebinds the parameters in the
+  // caller's frame and replaces the caller, whose lambda it releases
+  if(caller.call && (caller.program->code[caller.pc].op == Bytecode::RETURN)){
+    auto arg = args.begin();
+    std::size_t index = 0;
+    for(auto p = params.tailConstBegin(); p != params.tailConstEnd(); ++p, ++arg, ++index){
+      caller.call->scope.bind_param(index, p->head(), *arg);
+    }
+    caller.program = &body_of(value, caller.call->scope);
+    caller.pc = 0;
+    caller.call->lambda = std::move(value);
+    return;
+  }
+
+  std::unique_ptr<Activation> activation(new Activation(value, caller.env));
+  auto arg = args.begin();
+  std::size_t index = 0;
+  for(auto p = params.tailConstBegin(); p != params.tailConstEnd(); ++p, ++arg, ++index){
+    activation->scope.bind_param(index, p->head(), *arg);
+  }
+
+  Frame callee;
+  callee.program = &body_of(value, activation->scope);
+  callee.pc = 0;
+  callee.env = &activation->scope;
+  callee.call = std::move(activation);
+  frames.push_back(std::move(callee));
+  peak = std::max(peak, frames.size());
+}
+
+std::size_t VirtualMachine::peakFrames() const noexcept{
+  return peak;
+}
+
+std::size_t VirtualMachine::compiledLambdas() noexcept{
+  return compiled_lambdas;
+}
+
+Expression VirtualMachine::run(const Bytecode & program, Environment & env){
+
+  stack.clear();
+  frames.clear();
+  peak = 1;
+
+  Frame top;
+  top.program = &program;
+  top.pc = 0;
+  top.env = &env;
+  frames.push_back(std::move(top));
+
+  while(true){
+
+    if (global_status_flag > 0)
+    {
+      throw SemanticError("Error: interpreter kernel interrupted");
+    }
+
+    Frame & frame = frames.back();
+    const Bytecode::Instruction & ins = frame.program->code[frame.pc++];
+
+    switch(ins.op){
+    case Bytecode::PUSH:
+      stack.push_back(frame.program->constants[ins.a]);
+      break;
+    case Bytecode::LOAD:
+      stack.push_back(frame.program->constants[ins.a].eval(*frame.env));
+      break;
+    case Bytecode::CALL:
+      call(frame.program->constants[ins.a].head(), ins.b);
+      break;
+    case Bytecode::CALL_BUILTIN:
+      {
+        const Bytecode::ResolvedProcedure & resolved = frame.program->procedures[ins.a];
+
+        // a later define may have rebound the name
+        if(frame.env->is_exp(resolved.name)){
+          call(resolved.name, ins.b);
+          break;
+        }
+
+        // the arguments are read in place on the stack
+        Expression result = resolved.proc(ArgSpan(stack.data() + stack.size() - ins.b, ins.b));
+        if(ins.b == 0){
+          stack.push_back(std::move(result));
+        }
+        else{
+          // the result takes the place of the first argument
+          stack[stack.size() - ins.b] = std::move(result);
+          stack.resize(stack.size() - ins.b + 1);
+        }
+      }
+      break;
+    case Bytecode::DEFINE:
+      frame.env->add_exp(frame.program->constants[ins.a].head(), stack.back());
+      break;
+    case Bytecode::POP:
+      stack.pop_back();
+      break;
+    case Bytecode::EVAL:
+      stack.push_back(frame.program->constants[ins.a].eval(*frame.env));
+      break;
+    case Bytecode::RETURN:
+      frames.pop_back();
+      if(frames.empty()){
+        Expression result = std::move(stack.back());
+        stack.clear();
+        return result;
+      }
+      break;
+    }
+  }
+}
@@ -0,0 +1,143 @@
+/*! \file bytecode.hpp
+Defines the bytecode compiler and the stack-based virtual machine that
+executes it.
+
+The compiler translates a parsed Expression into a flat sequence of
+instructions over a constant pool. Procedure calls to built-ins are resolved
+to a slot in a procedure pool at compile time, and lambda bodies are compiled
+on their first call and kept with the lambda, so calling a lambda jumps
+directly into its code. Special forms whose behaviour depends on run-time values (apply, map,
+the property and plot forms, and malformed forms that must raise an error
+when evaluated) are executed by the tree-walking evaluator.
+ */
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+// system includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// module includes
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class Bytecode
+\brief A compiled program: instructions, constants and resolved procedures.
+ */
+class Bytecode {
+public:
+
+  /*! \enum Opcode
+    \brief The operations of the virtual machine.
+   */
+  enum Opcode : std::uint8_t {
+    PUSH,         //< push constants[a]
+    LOAD,         //< push the value of the leaf expression constants[a]
+    CALL,         //< call the procedure or lambda named by constants[a] with b arguments
+    CALL_BUILTIN, //< call procedures[a] with b arguments
+    DEFINE,       //< bind constants[a] to the top of the stack, leaving it there
+    POP,          //< discard the top of the stack
+    EVAL,         //< push the tree-walking evaluation of constants[a]
+    RETURN        //< return the top of the stack to the caller
+  };
+
+  /// a single instruction with up to two operands
+  struct Instruction {
+    Opcode op;
+    std::uint32_t a;
+    std::uint32_t b;
+  };
+
+  /// a built-in procedure resolved at compile time, with the name it was bound to
+  struct ResolvedProcedure {
+    Atom name;
+    Procedure proc;
+  };
+
+  /*! Compile an expression.
+    \param exp the expression to compile
+    \param env the environment used to resolve built-in procedures
+    \return the compiled program, ending in RETURN
+   */
+  static Bytecode compile(const Expression & exp, Environment & env);
+
+  /// the instructions
+  std::vector<Instruction> code;
+
+  /// the constant pool
+  std::vector<Expression> constants;
+
+  /// the resolved built-in procedures
+  std::vector<ResolvedProcedure> procedures;
+
+private:
+
+  // compile exp, appending to this program
+  void emit(const Expression & exp, Environment & env);
+
+  std::uint32_t constant(const Expression & exp);
+};
+
+/*! \class VirtualMachine
+\brief A stack machine that executes Bytecode.
+
+The machine keeps an explicit call stack, so lambda calls made from compiled
+code do not recurse on the native stack, and calls in tail position of a
+lambda body reuse the frame of the caller. The compiled body of a lambda is
+kept in the tail shared by the copies of the lambda, so it lives exactly as
+long as the lambda does.
+ */
+class VirtualMachine {
+public:
+
+  /*! Run a program to completion.
+    \param program the program to run
+    \param env the environment to evaluate in
+    \return the value the program returns
+    \throws SemanticError when a semantic error is encountered
+   */
+  Expression run(const Bytecode & program, Environment & env);
+
+  /// the most frames the last run held at once
+  std::size_t peakFrames() const noexcept;
+
+  /// the number of compiled lambda bodies alive, on all machines
+  static std::size_t compiledLambdas() noexcept;
+
+private:
+
+  // the state owned by a lambda call: the lambda, which keeps its compiled
+  // body alive, and the frame its parameters are bound in
+  struct Activation {
+    Expression lambda;
+    Environment scope;
+
+    Activation(const Expression & l, const Environment * parent): lambda(l), scope(parent){}
+
+    // every lambda call that is not a tail call creates one
+    static void * operator new(std::size_t size);
+    static void operator delete(void * p);
+  };
+
+  // an active call
+  struct Frame {
+    const Bytecode * program;
+    std::size_t pc;
+    Environment * env;
+    std::unique_ptr<Activation> call; // set in the frame of a lambda call
+  };
+
+  // call the value named op with the top argc values of the stack
+  void call(const Atom & op, std::uint32_t argc);
+
+  // return the compiled body of lambda, compiling it on first use
+  static const Bytecode & body_of(const Expression & lambda, Environment & env);
+
+  std::vector<Expression> stack;
+  std::vector<Frame> frames;
+  std::vector<Expression> args;
+  std::size_t peak = 0;
+};
+
+#endif
@@ -0,0 +1,6 @@
+// Runs the interpreter tests a second time with the bytecode engine selected,
+// so that both engines are held to the same behaviour.
+
+#include "interpreter.hpp"
+
+static const bool engine_selected = (Interpreter::setDefaultEngine(Interpreter::BytecodeEngine), true);
@@ -7,6 +7,7 @@
 #include "semantic_error.hpp"
 #include "expression.hpp"
 #include "interpreter.hpp"
+#include "parse.hpp"
 #include "startup_config.hpp"
 
 typedef std::string Input;
@@ -28,10 +29,8 @@ public:
 
   void operator()() const
   {
-    std::ifstream ifs(STARTUP_FILE);
     Interpreter interp;
-    interp.parseStream(ifs);
-    interp.evaluate();
+    load_startup(interp);
 
     while (true)
     {
@@ -43,9 +42,12 @@ public:
         break;
       }
 
-      std::istringstream expression(stringIn);
+      // an input is a program of one or more expressions, evaluated in
+      // order once the whole of it is known to parse
+      StreamParser parser;
+      parser.feed(stringIn.data(), stringIn.size());
 
-      if (!interp.parseStream(expression))
+      if (!parser.finish() || !interp.parseNext(parser))
       {
         std::string error = "Error: Invalid Expression. Could not parse.";
         outq->push(std::make_pair(Expression(),error));
@@ -55,6 +57,10 @@ public:
         try
         {
           Expression exp = interp.evaluate();
+          while (interp.parseNext(parser))
+          {
+            exp = interp.evaluate();
+          }
           outq->push(std::make_pair(exp,"NONE"));
         }
         catch(const SemanticError & ex)
@@ -67,6 +73,30 @@ public:
   }
 
 private:
+
+  // evaluate the startup file, each expression as soon as it has been read
+  static void load_startup(Interpreter & interp)
+  {
+    std::ifstream ifs(STARTUP_FILE);
+    StreamParser parser;
+
+    char block[4096];
+    while (ifs.read(block, sizeof(block)) || ifs.gcount() > 0)
+    {
+      parser.feed(block, static_cast<std::size_t>(ifs.gcount()));
+      while (interp.parseNext(parser))
+      {
+        interp.evaluate();
+      }
+    }
+
+    parser.finish();
+    while (interp.parseNext(parser))
+    {
+      interp.evaluate();
+    }
+  }
+
   Mq1 * inq;
   Mq2  * outq;
 };
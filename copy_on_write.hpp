@@ -0,0 +1,83 @@
+/*! \file copy_on_write.hpp
+Defines the CopyOnWrite container wrapper.
+ */
+#ifndef COPY_ON_WRITE_HPP
+#define COPY_ON_WRITE_HPP
+
+#include <memory>
+#include <utility>
+
+#include "pool_allocator.hpp"
+
+/*! \class CopyOnWrite
+\brief A reference-counted, copy-on-write handle to a standard container.
+
+Copying a CopyOnWrite shares the underlying container, so it costs O(1)
+regardless of the container size. Read access through a const handle never
+copies. Any non-const access first detaches, copying the container only if
+it is shared with another handle. An empty container is represented without
+allocating, and containers are allocated from a thread-local BlockPool.
+*/
+template<typename Container>
+class CopyOnWrite
+{
+public:
+
+  typedef typename Container::size_type size_type;
+  typedef typename Container::const_iterator const_iterator;
+
+  /// return the shared container for reading
+  const Container & get() const noexcept;
+
+  /// return a container unique to this handle for writing
+  Container & edit();
+
+  /// return the shared container as stored, or nullptr if there is none
+  const Container * stored() const noexcept;
+
+  size_type size() const noexcept;
+
+  bool empty() const noexcept;
+
+  /// return true if this handle is the only owner of a non-empty container
+  bool unique() const noexcept;
+
+  const_iterator begin() const noexcept;
+
+  const_iterator end() const noexcept;
+
+  const_iterator cbegin() const noexcept;
+
+  const_iterator cend() const noexcept;
+
+  /// drop this handle's reference, leaving it empty
+  void clear() noexcept;
+
+  template<typename Key>
+  auto operator[](const Key & key) const -> decltype(std::declval<const Container &>()[key]);
+
+  template<typename Key>
+  auto operator[](const Key & key) -> decltype(std::declval<Container &>()[key]);
+
+  template<typename Key>
+  auto at(const Key & key) const -> decltype(std::declval<const Container &>().at(key));
+
+  template<typename... Args>
+  void push_back(Args &&... args);
+
+  template<typename... Args>
+  void emplace_back(Args &&... args);
+
+  template<typename C = Container>
+  auto back() -> decltype(std::declval<C &>().back());
+
+private:
+
+  static const Container & empty_container();
+
+  std::shared_ptr<Container> data;
+};
+
+#include "copy_on_write.tpp"
+
+#endif
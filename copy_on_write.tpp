@@ -0,0 +1,124 @@
+#include "copy_on_write.hpp"
+
+template<typename Container>
+const Container & CopyOnWrite<Container>::empty_container()
+{
+  static const Container empty;
+  return empty;
+}
+
+template<typename Container>
+const Container & CopyOnWrite<Container>::get() const noexcept
+{
+  return data ? *data : empty_container();
+}
+
+template<typename Container>
+Container & CopyOnWrite<Container>::edit()
+{
+  if (!data)
+  {
+    data = std::allocate_shared<Container>(PoolAllocator<Container>());
+  }
+  else if (data.use_count() > 1)
+  {
+    data = std::allocate_shared<Container>(PoolAllocator<Container>(), *data);
+  }
+  return *data;
+}
+
+template<typename Container>
+const Container * CopyOnWrite<Container>::stored() const noexcept
+{
+  return data.get();
+}
+
+template<typename Container>
+typename CopyOnWrite<Container>::size_type CopyOnWrite<Container>::size() const noexcept
+{
+  return data ? data->size() : 0;
+}
+
+template<typename Container>
+bool CopyOnWrite<Container>::empty() const noexcept
+{
+  return !data || data->empty();
+}
+
+template<typename Container>
+bool CopyOnWrite<Container>::unique() const noexcept
+{
+  return data && (data.use_count() == 1) && !data->empty();
+}
+
+template<typename Container>
+typename CopyOnWrite<Container>::const_iterator CopyOnWrite<Container>::begin() const noexcept
+{
+  return get().cbegin();
+}
+
+template<typename Container>
+typename CopyOnWrite<Container>::const_iterator CopyOnWrite<Container>::end() const noexcept
+{
+  return get().cend();
+}
+
+template<typename Container>
+typename CopyOnWrite<Container>::const_iterator CopyOnWrite<Container>::cbegin() const noexcept
+{
+  return get().cbegin();
+}
+
+template<typename Container>
+typename CopyOnWrite<Container>::const_iterator CopyOnWrite<Container>::cend() const noexcept
+{
+  return get().cend();
+}
+
+template<typename Container>
+void CopyOnWrite<Container>::clear() noexcept
+{
+  data.reset();
+}
+
+template<typename Container>
+template<typename Key>
+auto CopyOnWrite<Container>::operator[](const Key & key) const -> decltype(std::declval<const Container &>()[key])
+{
+  return get()[key];
+}
+
+template<typename Container>
+template<typename Key>
+auto CopyOnWrite<Container>::operator[](const Key & key) -> decltype(std::declval<Container &>()[key])
+{
+  return edit()[key];
+}
+
+template<typename Container>
+template<typename Key>
+auto CopyOnWrite<Container>::at(const Key & key) const -> decltype(std::declval<const Container &>().at(key))
+{
+  return get().at(key);
+}
+
+template<typename Container>
+template<typename... Args>
+void CopyOnWrite<Container>::push_back(Args &&... args)
+{
+  edit().push_back(std::forward<Args>(args)...);
+}
+
+template<typename Container>
+template<typename... Args>
+void CopyOnWrite<Container>::emplace_back(Args &&... args)
+{
+  edit().emplace_back(std::forward<Args>(args)...);
+}
+
+template<typename Container>
+template<typename C>
+auto CopyOnWrite<Container>::back() -> decltype(std::declval<C &>().back())
+{
+  return edit().back();
+}
@@ -1,5 +1,6 @@
 #include "environment.hpp"
 
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <complex>
@@ -16,7 +17,7 @@ Helper Functions
 **********************************************************************/
 
 // predicate, the number of args is nargs
-bool nargs_equal(const std::vector<Expression> & args, unsigned nargs){
+bool nargs_equal(ArgSpan args, unsigned nargs){
   return args.size() == nargs;
 }
 
@@ -26,395 +27,435 @@ typedef'd Procedure function pointer.
 **********************************************************************/
 
 // the default procedure always returns an expresison of type None
-Expression default_proc(const std::vector<Expression> & args){
+Expression default_proc(ArgSpan args){
   args.size(); // make compiler happy we used this parameter
   return Expression();
 };
 
-Environment::Environment(const Environment & env)
-{
-  envmap = env.envmap;//copy over the current environment
+/***********************************************************************
+Procedure
+**********************************************************************/
+
+Procedure::Procedure(std::nullptr_t) noexcept:
+  function(nullptr), min_args(0), max_args(VARIADIC), arity_error(nullptr), kind(AnyKind), kind_error(nullptr),
+  broadcasts(false), kernel(nullptr), sequencer(nullptr){}
+
+Procedure::Procedure(Function function, std::size_t min_args, std::size_t max_args,
+                     const char * arity_error, ArgKind kind, const char * kind_error) noexcept:
+  function(function), min_args(min_args), max_args(max_args), arity_error(arity_error), kind(kind), kind_error(kind_error),
+  broadcasts(false), kernel(nullptr), sequencer(nullptr){}
+
+Procedure & Procedure::sequence(Sequencer s) noexcept{
+  sequencer = s;
+  return *this;
 }
 
-const std::vector<Expression> LIST = {};//empty list case for expression
+Procedure::Sequence Procedure::describe(ArgSpan args) const{
 
-//begin join
-Expression join(const std::vector<Expression> & args)
-{
-  if (!nargs_equal(args, 2))//check for correct arugmentes #
-  {
-    throw SemanticError("Error: two arguments for join not given");
+  if((args.size() < min_args) || (args.size() > max_args)){
+    fail(arity_error);
   }
-  else
-  {
-    if (args[0].isHeadList() && args[1].isHeadList())//both have to be list
-    {
-      std::vector<Expression> result;
-      for(auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); ++e)
-      {
-        result.push_back(*e);//push
-      }
+  for(const Expression & a : args){
+    if(!is_kind(a)){
+      fail(kind_error);
+    }
+  }
+  return sequencer(args);
+}
 
-      for(auto e = args[1].tailConstBegin(); e != args[1].tailConstEnd(); ++e)
-      {
-        result.push_back(*e);
+std::size_t Procedure::Sequence::size_hint() const noexcept{
+
+  const double MAX_HINT = 1 << 20;
+
+  double count = (end - begin) / step;
+  if(!(count >= 0)){
+    return 0;
+  }
+  return (count < MAX_HINT) ? static_cast<std::size_t>(count) + 1 : static_cast<std::size_t>(MAX_HINT);
+}
+
+Procedure & Procedure::elementwise(const Kernel * k) noexcept{
+  broadcasts = true;
+  kernel = k;
+  return *this;
+}
+
+bool Procedure::is_kind(const Expression & a) const noexcept{
+
+  switch(kind){
+  case NumberKind:
+    return a.isHeadNumber();
+  case ComplexKind:
+    return a.isHeadComplex();
+  case ListKind:
+    return a.isHeadList();
+  default:
+    return true;
+  }
+}
+
+void Procedure::fail(const char * message){
+  throw SemanticError(message != nullptr ? message : "Error during evaluation: invalid arguments to procedure");
+}
+
+Expression Procedure::broadcast(ArgSpan args) const{
+
+  // every list must have the same length
+  std::size_t length = 0;
+  bool found = false;
+  for(const Expression & a : args){
+    if(a.isHeadList()){
+      std::size_t n = a.tailSize();
+      if(found && (n != length)){
+        fail("Error during evaluation: lists of different lengths in element-wise call");
       }
-      return Expression(result);
+      length = n;
+      found = true;
     }
-    else
-    {
-      throw SemanticError("Error: argument to join not a list");//error
+  }
+
+  std::vector<double> numbers;
+  if((kernel != nullptr) && broadcast_packed(args, length, numbers)){
+    return Expression(std::move(numbers));
+  }
+
+  // otherwise call the procedure once per element, which checks each
+  // element and broadcasts again over nested lists
+  std::vector<Expression> result;
+  result.reserve(length);
+  std::vector<Expression> element(args.size());
+  for(std::size_t i = 0; i < length; ++i){
+    for(std::size_t j = 0; j < args.size(); ++j){
+      element[j] = args[j].isHeadList() ? args[j].getTail(i) : args[j];
     }
+    result.push_back((*this)(element));
   }
-  return Expression();
+  return Expression(std::move(result));
 }
 
-Expression append(const std::vector<Expression> & args)
-{
-  if (!nargs_equal(args,2))//check for number of arguments
-  {
-    throw SemanticError("Error: two arguments for append not given");
-  }
-  else
-  {
-    if (!args[0].isHeadList())//is head not list
-    {
-      throw SemanticError("Error: first argument to append not a list");
+bool Procedure::broadcast_packed(ArgSpan args, std::size_t length, std::vector<double> & out) const{
+
+  // the kernel only reads packed lists and real numbers
+  for(const Expression & a : args){
+    if(!a.isPackedList() && !(a.isHeadNumber() && (a.getPropSize() == 0))){
+      return false;
     }
-    else
-    {
-      std::vector<Expression> result;
-      for(auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); ++e)
-      {
-        result.push_back(*e);//push back
-      }
-      if (args[1].isHeadList())
-      {
-        for(auto e = args[1].tailConstBegin(); e != args[1].tailConstEnd(); ++e)
-        {
-          result.push_back(*e);
-        }
+  }
+
+  out.resize(length);
+
+  if(args.size() == 1){
+    return (kernel->unary != nullptr) && kernel->unary(args[0].packedNumbers().data(), out.data(), length);
+  }
+  if(kernel->binary == nullptr){
+    return false;
+  }
+
+  // fold the arguments from the left, as the procedure does, keeping the
+  // result so far in out, or in scalar while every argument was a number
+  bool packed = false;
+  double scalar = args[0].head().asNumber();
+  if(args[0].isPackedList()){
+    std::copy(args[0].packedNumbers().begin(), args[0].packedNumbers().end(), out.begin());
+    packed = true;
+  }
+
+  for(std::size_t j = 1; j < args.size(); ++j){
+    const Expression & b = args[j];
+    if(b.isPackedList()){
+      if(packed){
+        kernel->binary(out.data(), b.packedNumbers().data(), out.data(), length);
       }
-      else
-      {
-        result.push_back(args[1]);
+      else{
+        kernel->left(scalar, b.packedNumbers().data(), out.data(), length);
       }
-      return Expression(result);
+      packed = true;
+    }
+    else if(packed){
+      kernel->right(out.data(), b.head().asNumber(), out.data(), length);
+    }
+    else{
+      kernel->right(&scalar, b.head().asNumber(), &scalar, 1);
     }
   }
-  return Expression();
+  return true;
 }
 
-//range procedures
-Expression range(const std::vector<Expression> & args)
+// the source of version stamps, shared by all environments on all threads
+static std::atomic<std::uint64_t> next_version(1);
+
+Environment::Environment(const Environment & env): table(env.table), count(env.count), params(env.params), mask(env.mask), parent(env.parent), version(0)
+{
+  // a copy is modified independently, so it needs a stamp of its own
+  touch();
+}
+
+Environment::Environment(const Environment * parent): count(0), mask(0), parent(parent), version(0){}
+
+const std::vector<Expression> LIST = {};//empty list case for expression
+
+//begin join
+Expression join(ArgSpan args)
 {
-  if (nargs_equal(args,3))
+  if (args[0].isPackedList() && args[1].isPackedList())
   {
-    if (args[0].head().isNumber() && args[1].head().isNumber() && args[2].head().isNumber())//check for all args
-    {
-      if (args[2].head().asNumber() <= 0)
-      {
-        throw SemanticError("Error: negative or zero increment in range");//error
-      }
+    std::vector<double> numbers(args[0].packedNumbers());
+    numbers.insert(numbers.end(), args[1].packedNumbers().begin(), args[1].packedNumbers().end());
+    return Expression(std::move(numbers));
+  }
 
-      if (args[1].head().asNumber() < args[0].head().asNumber())
-      {
-        throw SemanticError("Error: begin greater than end in range");
-      }
-      double beginValue = args[0].head().asNumber();//get the variables to make the list
-      double endValue = args[1].head().asNumber();
-      double incrementValue = args[2].head().asNumber();
-      std::vector<Expression> result;
-      for (double i = beginValue; i <= endValue; i += incrementValue)
-      {
-        result.push_back(Expression(i));
-      }
-      return (Expression(result));
+  std::vector<Expression> result;
+  result.reserve(args[0].tailSize() + args[1].tailSize());
+  result.insert(result.end(), args[0].tailConstBegin(), args[0].tailConstEnd());//push
+  result.insert(result.end(), args[1].tailConstBegin(), args[1].tailConstEnd());
+  return Expression(std::move(result));
+}
+
+Expression append(ArgSpan args)
+{
+  if (!args[0].isHeadList())//is head not list
+  {
+    throw SemanticError("Error: first argument to append not a list");
+  }
+
+  // a packed list stays packed when a number or another packed list is appended
+  if (args[0].isPackedList())
+  {
+    if (args[1].isHeadNumber() && (args[1].getPropSize() == 0))
+    {
+      std::vector<double> numbers;
+      numbers.reserve(args[0].tailSize() + 1);
+      numbers.assign(args[0].packedNumbers().begin(), args[0].packedNumbers().end());
+      numbers.push_back(args[1].head().asNumber());
+      return Expression(std::move(numbers));
     }
-    else
+    if (args[1].isPackedList())
     {
-      throw SemanticError("Error: one of the arguments is not a number");
+      return join(args);
     }
   }
+
+  std::vector<Expression> result;
+  result.reserve(args[0].tailSize() + (args[1].isHeadList() ? args[1].tailSize() : 1));
+  result.insert(result.end(), args[0].tailConstBegin(), args[0].tailConstEnd());//push back
+  if (args[1].isHeadList())
+  {
+    result.insert(result.end(), args[1].tailConstBegin(), args[1].tailConstEnd());
+  }
   else
   {
-    throw SemanticError("Error: did not give 3 arguments");
+    result.push_back(args[1]);
   }
-    return Expression();
+  return Expression(std::move(result));
 }
 
-//length Procedure
-Expression length(const std::vector<Expression> & args)
+//range procedures
+Procedure::Sequence rangeSequence(ArgSpan args)
 {
-  if (nargs_equal(args,1))//lenghth takea lsit
+  if (args[2].head().asNumber() <= 0)
   {
-    if (!args[0].isHeadList())
-    {
-      throw SemanticError("Error: argument to length is not a list");
-    }
-    else
-    {
-      int counter = 0;
-      for (auto it = args[0].tailConstBegin(); it != args[0].tailConstEnd(); ++it)
-      {
-        counter++;
-      }
-      return Expression(counter);//return count
-    }
+    throw SemanticError("Error: negative or zero increment in range");//error
   }
-  else
+
+  if (args[1].head().asNumber() < args[0].head().asNumber())
+  {
+    throw SemanticError("Error: begin greater than end in range");
+  }
+  //get the variables to make the list
+  return Procedure::Sequence{args[0].head().asNumber(), args[1].head().asNumber(), args[2].head().asNumber()};
+}
+
+Expression range(ArgSpan args)
+{
+  Procedure::Sequence s = rangeSequence(args);
+  std::vector<double> result;
+  result.reserve(s.size_hint());
+  for (double i = s.begin; i <= s.end; i += s.step)
   {
-    throw SemanticError("Error: not enough or too many arguments in call to length");
+    result.push_back(i);
   }
+  return Expression(std::move(result));
+}
+
+//length Procedure
+Expression length(ArgSpan args)
+{
+  return Expression(args[0].tailSize());//return count
 }
 
 //first procedure
-Expression first(const std::vector<Expression> & args)
+Expression first(ArgSpan args)
 {
-  if (nargs_equal(args,1))
+  if (args[0].head().isNone())
   {
-    if (args[0].head().isNone())
-    {
-      throw SemanticError("Error: argument to first is an empty list");
-    }
-    if (!args[0].isHeadList())
-    {
-      throw SemanticError("Error: argument to first is not a list");
-    }
-    else
-    {
-      if (args[0].tailSize() == 0)
-      {
-        throw SemanticError("Error: argument to first is an empty list");
-      }
-      return Expression(args[0].getExpressionFirst());//get first element of list
-    }
+    throw SemanticError("Error: argument to first is an empty list");
+  }
+  if (!args[0].isHeadList())
+  {
+    throw SemanticError("Error: argument to first is not a list");
   }
-  else if (args.size() > 1)
+  if (args[0].tailSize() == 0)
   {
-    throw SemanticError("Error: more than one argument in call to first");
+    throw SemanticError("Error: argument to first is an empty list");
   }
+  if (args[0].isPackedList())
+  {
+    return Expression(Atom(args[0].packedNumbers().front()));
+  }
+  return Expression(args[0].getExpressionFirst());//get first element of list
 }
 
 //rest procedure
-Expression rest(const std::vector<Expression> & args)
+Expression rest(ArgSpan args)
 {
-  std::vector<Expression> result;
-  if (nargs_equal(args,1))
+  if (args[0].head().isNone())
   {
-    if (args[0].head().isNone())
-    {
-      throw SemanticError("Error: argument to rest is an empty list");
-    }
-    if (!args[0].isHeadList())
-    {
-      throw SemanticError("Error: argument to rest is not a list");
-    }
-    else
-    {
-      if (args[0].tailSize() == 0)//return if tail is zero
-      {
-        throw SemanticError("Error: argument to rest is an empty list");
-      }
-      for(auto e = args[0].tailConstBegin()+1; e != args[0].tailConstEnd(); ++e)
-      {
-        result.push_back(*e);
-      }
-      return Expression(result);//return expression
-    }
+    throw SemanticError("Error: argument to rest is an empty list");
   }
-  else if (args.size() > 1)
+  if (!args[0].isHeadList())
   {
-    throw SemanticError("Error: more than one argument in call to rest");
+    throw SemanticError("Error: argument to rest is not a list");
   }
+  if (args[0].tailSize() == 0)
+  {
+    throw SemanticError("Error: argument to rest is an empty list");
+  }
+  if (args[0].isPackedList())
+  {
+    std::vector<double> numbers(args[0].packedNumbers().begin() + 1, args[0].packedNumbers().end());
+    return Expression(std::move(numbers));
+  }
+  std::vector<Expression> result(args[0].tailConstBegin()+1, args[0].tailConstEnd());
+  return Expression(std::move(result));//return expression
 }
 
 //added list function
-Expression list(const std::vector<Expression> & args)
+Expression list(ArgSpan args)
 {
-  std::vector<Expression> result;//empty vectro
+  std::vector<Expression> result(args.begin(), args.end());
 
-  for (auto & a : args)
-  {
-    result.push_back(a);
-  }
-  return Expression(result);//return after putting arguments
+  return Expression(std::move(result));//return after putting arguments
 };
 
 //added sqrt function
-Expression squareroot(const std::vector<Expression> & args)
+Expression squareroot(ArgSpan args)
 {
-  double result = 0;
+  const Expression & a = args[0];
 
-  if (nargs_equal(args,1))//if # or args is 1
+  if (a.isHeadNumber())//is it a number?
   {
-    for (auto & a : args)
+    if (a.head().asNumber() < 0)//is negative
     {
-      if (a.isHeadNumber())//is it a number?
-      {
-        if (a.head().asNumber() < 0)//is negative
-        {
-          std::complex<double> complexResult = std::sqrt(std::complex<double>(a.head().asNumber(),0));//squareroot
-          return Expression(complexResult);
-        }
-        else
-        {
-            result = std::sqrt(a.head().asNumber());//calculate squareroot
-        }
-      }
-      else if (a.isHeadComplex())//is complex
-      {
-        std::complex<double> complexsqrt = std::sqrt(a.head().asComplex());
-        return Expression(complexsqrt);
-      }
+      std::complex<double> complexResult = std::sqrt(std::complex<double>(a.head().asNumber(),0));//squareroot
+      return Expression(complexResult);
     }
+    return Expression(std::sqrt(a.head().asNumber()));//calculate squareroot
   }
-  else
+  else if (a.isHeadComplex())//is complex
   {
-    throw SemanticError("Error in call to exponential: invalid number of arguments.");
+    std::complex<double> complexsqrt = std::sqrt(a.head().asComplex());
+    return Expression(complexsqrt);
   }
-  return Expression(result);
+  return Expression(0.0);
 };
 //end of sqrt function
 
 //added exponential function
-Expression exponential(const std::vector<Expression> & args)
+Expression exponential(ArgSpan args)
 {
+  if(args[0].isHeadNumber() && args[1].isHeadNumber()){
+    return Expression(std::pow(args[0].head().asNumber(), args[1].head().asNumber()));
+  }
+
   double result = 0;
 
-  if(nargs_equal(args,2))//if # or args is 2
+  if ((args[0].isHeadComplex()) || (args[1].isHeadComplex()))//find which arg is complex
   {
-    if ((args[0].isHeadComplex()) || (args[1].isHeadComplex()))//find which arg is complex
+    std::complex<double> complexResult;
+    if (args[0].isHeadComplex() && args[1].isHeadNumber())//which arg is complex
     {
-      std::complex<double> complexResult;
-      if (args[0].isHeadComplex() && args[1].isHeadNumber())//which arg is complex
-      {
-        complexResult = std::pow(args[0].head().asComplex(), args[1].head().asNumber());
-      }
-      else if (args[1].isHeadComplex() && args[0].isHeadNumber())
-      {
-        complexResult = std::pow(args[0].head().asNumber(), args[1].head().asComplex());
-      }
-      else
-      {
-        complexResult = std::pow(args[0].head().asComplex(), args[1].head().asComplex());
-      }
-      return Expression(complexResult);
+      complexResult = std::pow(args[0].head().asComplex(), args[1].head().asNumber());
     }
-    else if((args[0].isHeadNumber()) && (args[1].isHeadNumber()))//is both numbers
+    else if (args[1].isHeadComplex() && args[0].isHeadNumber())
     {
-      result = std::pow(args[0].head().asNumber(),args[1].head().asNumber());
+      complexResult = std::pow(args[0].head().asNumber(), args[1].head().asComplex());
     }
+    else
+    {
+      complexResult = std::pow(args[0].head().asComplex(), args[1].head().asComplex());
+    }
+    return Expression(complexResult);
   }
-  else
+  else if((args[0].isHeadNumber()) && (args[1].isHeadNumber()))//is both numbers
   {
-    throw SemanticError("Error in call to exponential: invalid number of arguments.");
+    result = std::pow(args[0].head().asNumber(),args[1].head().asNumber());
   }
   return Expression(result);
 };
 //end of exponential function
 
 //added natural log function
-Expression naturalLog(const std::vector<Expression> & args)
+Expression naturalLog(ArgSpan args)
 {
   double result = 0;
 
   for (auto & a : args)
   {
-    if (a.isHeadNumber())//is number
-    {
-      if (a.head().asNumber() < 0)//if number is negative
-      {
-        throw SemanticError("Error in call to naturalLog, argument is negative");
-      }
-      if(!nargs_equal(args,1))//if # or args is 1
-      {
-        throw SemanticError("Error in call to naturalLog, too many arguments");
-      }
-      result = std::log(a.head().asNumber());//take log
-    }
-    else
+    if (a.head().asNumber() < 0)//if number is negative
     {
-      throw SemanticError("Error in call to naturalLog, argument not a number");
+      throw SemanticError("Error in call to naturalLog, argument is negative");
     }
+    result = std::log(a.head().asNumber());//take log
   }
   return Expression(result);
 };
 //end of natural log function
 
 //added sin function
-Expression sine(const std::vector<Expression> & args)
+Expression sine(ArgSpan args)
 {
   double result = 0;
 
   for (auto & a : args)
   {
-    if (a.isHeadNumber())
-    {
-      if(!nargs_equal(args,1))//is number of args not 1
-      {
-        throw SemanticError("Error in call to sine, too many arguments");
-      }
-      result = std::sin(a.head().asNumber());//take sine
-    }
-    else
-    {
-      throw SemanticError("Error in call to sine, argument not a number");
-    }
+    result = std::sin(a.head().asNumber());//take sin
   }
   return Expression(result);
 };
 //end of sin function
 
 //added cos function
-Expression cosine(const std::vector<Expression> & args)
+Expression cosine(ArgSpan args)
 {
   double result = 0;
 
   for (auto & a : args)
   {
-    if (a.isHeadNumber())
-    {
-      if(!nargs_equal(args,1))
-      {
-        throw SemanticError("Error in call to cosine, too many arguments");
-      }
-      result = std::cos(a.head().asNumber());//take cos
-    }
-    else
-    {
-      throw SemanticError("Error in call to cosine, argument not a number");
-    }
+    result = std::cos(a.head().asNumber());//take cos
   }
   return Expression(result);
 };
 //end of cos function
 
 //added tan function
-Expression tangent(const std::vector<Expression> & args)
+Expression tangent(ArgSpan args)
 {
   double result = 0;
 
   for (auto & a : args)
   {
-    if (a.isHeadNumber())//is number
-    {
-      if(!nargs_equal(args,1))//is number of args not 1
-      {
-        throw SemanticError("Error in call to tangent, too many arguments");
-      }
-      result = std::tan(a.head().asNumber());//take tan
-    }
-    else
-    {
-      throw SemanticError("Error in call to tangent, argument not a number");
-    }
+    result = std::tan(a.head().asNumber());//take tan
   }
   return Expression(result);
 };
 //end of tan function
 
-Expression add(const std::vector<Expression> & args){
+Expression add(ArgSpan args){
+
+  // the common case of two reals needs no loop and no complex arithmetic
+  if((args.size() == 2) && args[0].isHeadNumber() && args[1].isHeadNumber()){
+    return Expression(args[0].head().asNumber() + args[1].head().asNumber());
+  }
 
   // check all aruments are numbers, while adding
   double result = 0;
@@ -453,7 +494,11 @@ Expression add(const std::vector<Expression> & args){
   return Expression(result);
 };
 
-Expression mul(const std::vector<Expression> & args){
+Expression mul(ArgSpan args){
+
+  if((args.size() == 2) && args[0].isHeadNumber() && args[1].isHeadNumber()){
+    return Expression(args[0].head().asNumber() * args[1].head().asNumber());
+  }
 
   // check all aruments are numbers, while multiplying
   double result = 1;
@@ -492,7 +537,11 @@ Expression mul(const std::vector<Expression> & args){
   return Expression(result);
 };
 
-Expression subneg(const std::vector<Expression> & args){
+Expression subneg(ArgSpan args){
+
+  if((args.size() == 2) && args[0].isHeadNumber() && args[1].isHeadNumber()){
+    return Expression(args[0].head().asNumber() - args[1].head().asNumber());
+  }
 
   double result = 0;
 
@@ -510,7 +559,7 @@ Expression subneg(const std::vector<Expression> & args){
       throw SemanticError("Error in call to negate: invalid argument.");
     }
   }
-  else if(nargs_equal(args,2)){//2 arguments
+  else{//2 arguments
     if( (args[0].isHeadNumber()) && (args[1].isHeadNumber()) ){//both numbers?
       result = args[0].head().asNumber() - args[1].head().asNumber();//subtract
     }
@@ -535,14 +584,15 @@ Expression subneg(const std::vector<Expression> & args){
       throw SemanticError("Error in call to subtraction: invalid argument.");
     }
   }
-  else{
-    throw SemanticError("Error in call to subtraction or negation: invalid number of arguments.");
-  }
 
   return Expression(result);
 };
 
-Expression div(const std::vector<Expression> & args){
+Expression div(ArgSpan args){
+
+  if((args.size() == 2) && args[0].isHeadNumber() && args[1].isHeadNumber()){
+    return Expression(args[0].head().asNumber() / args[1].head().asNumber());
+  }
 
   double result = 0;
 
@@ -571,7 +621,7 @@ Expression div(const std::vector<Expression> & args){
       throw SemanticError("Error in call to division: invalid argument.");
     }
   }
-  else if (nargs_equal(args,1))
+  else
   {
     if (args[0].isHeadComplex())
     {
@@ -589,141 +639,297 @@ Expression div(const std::vector<Expression> & args){
       throw SemanticError("Error in call to division: value not number or complex.");
     }
   }
-  else{
-    throw SemanticError("Error in call to division: invalid number of arguments.");
-  }
   return Expression(result);
 };
 
 //functon to output real part of complex
-Expression realComplex(const std::vector<Expression> & args)
+Expression realComplex(ArgSpan args)
 {
-  if (nargs_equal(args,1))
-  {
-    if (!args[0].isHeadComplex())//error checking
-    {
-      throw SemanticError("Error in call to real, argument not complex");
-    }
-  }
-  else
-  {
-    throw SemanticError("Error in call to real: invalid number of arguments.");
-  }
-  return Expression(args[0].head().asComplex().real());//get real
+  return Expression(args[0].head().asComplex().real());
 };
 //end of realComplex function
 
 //functon to output imag part of complex
-Expression imagComplex(const std::vector<Expression> & args)
+Expression imagComplex(ArgSpan args)
 {
-  if (nargs_equal(args,1))
-  {
-    if (!args[0].isHeadComplex())
-    {
-      throw SemanticError("Error in call to imaginary, argument not complex");
-    }
-  }
-  else
-  {
-    throw SemanticError("Error in call to imaginary: invalid number of arguments.");
-  }
-  return Expression(args[0].head().asComplex().imag());//get imaginary
+  return Expression(args[0].head().asComplex().imag());
 };
 //end of imagComplex function
 
 //functon to output mag part of complex
-Expression magComplex(const std::vector<Expression> & args)
+Expression magComplex(ArgSpan args)
 {
-  if (nargs_equal(args,1))
-  {
-    if (!args[0].isHeadComplex())
-    {
-      throw SemanticError("Error in call to mag, argument not complex");
-    }
-  }
-  else
-  {
-    throw SemanticError("Error in call to mag: invalid number of arguments.");
-  }
-  return Expression(std::abs(args[0].head().asComplex()));//get magnitude
+  return Expression(std::abs(args[0].head().asComplex()));
 };
 //end of magComplex function
 
 //functon to output arg part of complex
-Expression argComplex(const std::vector<Expression> & args)
+Expression argComplex(ArgSpan args)
 {
-  if (nargs_equal(args,1))
-  {
-    if (!args[0].isHeadComplex())
-    {
-      throw SemanticError("Error in call to arg, argument not complex");
-    }
-  }
-  else
-  {
-    throw SemanticError("Error in call to arg: invalid number of arguments.");
-  }
-  return Expression(std::arg(args[0].head().asComplex()));//getp hase
+  return Expression(std::arg(args[0].head().asComplex()));
 };
 //end of argComplex function
 
 //functon to output conj part of complex
-Expression conjComplex(const std::vector<Expression> & args)
+Expression conjComplex(ArgSpan args)
 {
-  if (nargs_equal(args,1))// only 1 arg
-  {
-    if (!args[0].isHeadComplex())//if not complex
-    {
-      throw SemanticError("Error in call to conj, argument not complex");
-    }
-  }
-  else
-  {
-    throw SemanticError("Error in call to conj: invalid number of arguments.");
-  }
-  return Expression(std::conj(args[0].head().asComplex()));//return conjugate
+  return Expression(std::conj(args[0].head().asComplex()));
 };
 //end of conjComplex function
 
+/***********************************************************************
+Element-wise kernels
+
+Each operation is a function object, so that a loop over whole arrays is
+instantiated for it and the compiler can vectorize the loop.
+**********************************************************************/
+
+struct Plus { static double apply(double a, double b){ return a + b; } };
+struct Minus { static double apply(double a, double b){ return a - b; } };
+struct Times { static double apply(double a, double b){ return a * b; } };
+struct Divide { static double apply(double a, double b){ return a / b; } };
+struct Power { static double apply(double a, double b){ return std::pow(a, b); } };
+
+// a unary operation whose result is real for every real argument
+struct Total { static bool real(double){ return true; } };
+
+struct Negate : Total { static double apply(double a){ return -a; } };
+struct Reciprocal : Total { static double apply(double a){ return 1.0 / a; } };
+struct Sine : Total { static double apply(double a){ return std::sin(a); } };
+struct Cosine : Total { static double apply(double a){ return std::cos(a); } };
+struct Tangent : Total { static double apply(double a){ return std::tan(a); } };
+
+// the square root and log of a negative number are left to the procedure,
+// which makes a complex number or raises an error
+struct SquareRoot { static bool real(double a){ return !(a < 0); }
+                    static double apply(double a){ return std::sqrt(a); } };
+struct Log { static bool real(double a){ return !(a < 0); }
+             static double apply(double a){ return std::log(a); } };
+
+template<typename Op>
+bool unary_loop(const double * a, double * out, std::size_t n){
+  bool real = true;
+  for(std::size_t i = 0; i < n; ++i){
+    real &= Op::real(a[i]);
+  }
+  if(!real){
+    return false;
+  }
+  for(std::size_t i = 0; i < n; ++i){
+    out[i] = Op::apply(a[i]);
+  }
+  return true;
+}
+
+template<typename Op>
+void binary_loop(const double * a, const double * b, double * out, std::size_t n){
+  for(std::size_t i = 0; i < n; ++i){
+    out[i] = Op::apply(a[i], b[i]);
+  }
+}
+
+template<typename Op>
+void left_loop(double a, const double * b, double * out, std::size_t n){
+  for(std::size_t i = 0; i < n; ++i){
+    out[i] = Op::apply(a, b[i]);
+  }
+}
+
+template<typename Op>
+void right_loop(const double * a, double b, double * out, std::size_t n){
+  for(std::size_t i = 0; i < n; ++i){
+    out[i] = Op::apply(a[i], b);
+  }
+}
+
+const Procedure::Kernel ADD_KERNEL = {nullptr, binary_loop<Plus>, left_loop<Plus>, right_loop<Plus>};
+const Procedure::Kernel SUBNEG_KERNEL = {unary_loop<Negate>, binary_loop<Minus>, left_loop<Minus>, right_loop<Minus>};
+const Procedure::Kernel MUL_KERNEL = {nullptr, binary_loop<Times>, left_loop<Times>, right_loop<Times>};
+const Procedure::Kernel DIV_KERNEL = {unary_loop<Reciprocal>, binary_loop<Divide>, left_loop<Divide>, right_loop<Divide>};
+const Procedure::Kernel EXP_KERNEL = {nullptr, binary_loop<Power>, left_loop<Power>, right_loop<Power>};
+const Procedure::Kernel SQRT_KERNEL = {unary_loop<SquareRoot>, nullptr, nullptr, nullptr};
+const Procedure::Kernel LN_KERNEL = {unary_loop<Log>, nullptr, nullptr, nullptr};
+const Procedure::Kernel SIN_KERNEL = {unary_loop<Sine>, nullptr, nullptr, nullptr};
+const Procedure::Kernel COS_KERNEL = {unary_loop<Cosine>, nullptr, nullptr, nullptr};
+const Procedure::Kernel TAN_KERNEL = {unary_loop<Tangent>, nullptr, nullptr, nullptr};
+
 //CONSTANTS defined
 
 const double PI = std::atan2(0, -1);
 const double EXP = std::exp(1);
 const std::complex<double> I(0.0,1.0);
 
-Environment::Environment(){
+Environment::Environment(): count(0), mask(0), parent(nullptr), version(0){
   reset();
 }
 
-bool Environment::is_known(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
+// ids are interned sequentially, so the low bits of an id are already well
+// distributed and serve as its hash
+const Environment::EnvResult * Environment::find_local(SymbolTable::IdType id) const{
+
+  for(const Slot & slot : params){
+    if(slot.key == id){
+      return &slot.result;
+    }
+  }
+
+  if(count == 0){
+    return nullptr;
+  }
 
-  return envmap.find(sym.asSymbol()) != envmap.end();
+  std::size_t last = table.size() - 1;
+  for(std::size_t i = id & last; ; i = (i + 1) & last){
+    const Slot & slot = table[i];
+    if(slot.key == id){
+      return &slot.result;
+    }
+    if(slot.key == EMPTY_KEY){
+      return nullptr;
+    }
+  }
 }
 
-bool Environment::is_exp(const Atom & sym) const{
-  if(!sym.isSymbol())
-  {
-    return false;
+void Environment::touch() noexcept{
+
+  // frames are checked binding by binding when a cache is used, so only
+  // the top level needs a version
+  if(parent == nullptr){
+    version = next_version.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+Environment::EnvResult & Environment::insert(SymbolTable::IdType id){
+
+  touch();
+
+  // keep the table at most half full
+  if(2 * (count + 1) > table.size()){
+    std::vector<Slot, PoolAllocator<Slot>> old(table.empty() ? 8 : 2 * table.size());
+    old.swap(table);
+
+    std::size_t last = table.size() - 1;
+    for(auto & slot : old){
+      if(slot.key != EMPTY_KEY){
+        std::size_t i = slot.key & last;
+        while(table[i].key != EMPTY_KEY){
+          i = (i + 1) & last;
+        }
+        table[i].key = slot.key;
+        table[i].result = std::move(slot.result);
+      }
+    }
+  }
+
+  std::size_t last = table.size() - 1;
+  std::size_t i = id & last;
+  while(table[i].key != id && table[i].key != EMPTY_KEY){
+    i = (i + 1) & last;
   }
 
-  auto result = envmap.find(sym.asSymbol());
+  if(table[i].key == EMPTY_KEY){
+    table[i].key = id;
+    ++count;
+    mask |= std::uint64_t(1) << (id & 63);
+  }
 
-  return (result != envmap.end()) && (result->second.type == ExpressionType);
+  return table[i].result;
 }
 
-Expression Environment::get_exp(const Atom & sym) const{
+const Environment::EnvResult * Environment::find(const Atom & sym) const{
+
+  if(!sym.isSymbol()){
+    return nullptr;
+  }
 
-  Expression exp;
+  SymbolTable::IdType id = sym.symbolId();
+  std::uint64_t bit = std::uint64_t(1) << (id & 63);
 
-  if(sym.isSymbol()){
-    auto result = envmap.find(sym.asSymbol());
-    if((result != envmap.end()) && (result->second.type == ExpressionType)){
-      exp = result->second.exp;
+  for(const Environment * frame = this; frame != nullptr; frame = frame->parent){
+    if(frame->mask & bit){
+      const EnvResult * result = frame->find_local(id);
+      if(result != nullptr){
+        return result;
+      }
     }
   }
 
-  return exp;
+  return nullptr;
+}
+
+const Expression * Environment::lookup(const Atom & sym) const{
+
+  static const Expression none;
+
+  const EnvResult * result = find(sym);
+  if(result == nullptr){
+    return nullptr;
+  }
+
+  return (result->type == ExpressionType) ? &result->exp : &none;
+}
+
+const Expression * Environment::get_param(std::size_t index, SymbolTable::IdType id) const noexcept{
+
+  if((index < params.size()) && (params[index].key == id)){
+    return &params[index].result.exp;
+  }
+
+  return nullptr;
+}
+
+void Environment::bind_param(std::size_t index, const Atom & sym, const Expression & exp){
+
+  if(!sym.isSymbol()){
+    throw SemanticError("Attempt to add non-symbol to environment");
+  }
+
+  SymbolTable::IdType id = sym.symbolId();
+
+  // a parameter of the same lambda bound again, e.g. by a tail call
+  if((index < params.size()) && (params[index].key == id)){
+    params[index].result.exp = exp;
+    return;
+  }
+
+  // parameters are only positional when bound in order and not already
+  // bound in this frame under another position
+  if((index != params.size()) || (find_local(id) != nullptr)){
+    add_exp(sym, exp);
+    return;
+  }
+
+  if(params.empty()){
+    params.reserve(4);
+  }
+  params.emplace_back();
+  params.back().key = id;
+  params.back().result.type = ExpressionType;
+  params.back().result.exp = exp;
+  mask |= std::uint64_t(1) << (id & 63);
+}
+
+bool Environment::is_known(const Atom & sym) const{
+
+  return find(sym) != nullptr;
+}
+
+bool Environment::is_exp(const Atom & sym) const{
+
+  const EnvResult * result = find(sym);
+
+  return (result != nullptr) && (result->type == ExpressionType);
+}
+
+const Expression & Environment::get_exp(const Atom & sym) const{
+
+  static const Expression none;
+
+  const EnvResult * result = find(sym);
+  if((result != nullptr) && (result->type == ExpressionType)){
+    return result->exp;
+  }
+
+  return none;
 }
 
 void Environment::add_exp(const Atom & sym, const Expression & exp){
@@ -733,134 +939,213 @@ void Environment::add_exp(const Atom & sym, const Expression & exp){
   }
 
   // error if overwriting symbol map
-  /*if(envmap.find(sym.asSymbol()) != envmap.end()){
+  /*if(envmap.find(sym.symbolId()) != envmap.end()){
     throw SemanticError("Attempt to overwrite symbol in environemnt");
   }*/
-  std::map<std::string, EnvResult>::iterator it;
-  it = envmap.find(sym.asSymbol());
 
-  if (it != envmap.end())
-  {
-    envmap.erase(it);
+  // binding in place replaces any previous binding
+  SymbolTable::IdType id = sym.symbolId();
+  for(Slot & slot : params){
+    if(slot.key == id){
+      slot.result.exp = exp;
+      return;
+    }
   }
-  envmap.emplace(sym.asSymbol(), EnvResult(ExpressionType, exp));
+
+  EnvResult & result = insert(id);
+  result.type = ExpressionType;
+  result.exp = exp;
 }
 
 bool Environment::is_proc(const Atom & sym) const{
-  if(!sym.isSymbol())
-  {
-    return false;
-  }
-  auto result = envmap.find(sym.asSymbol());
-  return (result != envmap.end()) && (result->second.type == ProcedureType);
+
+  const EnvResult * result = find(sym);
+
+  return (result != nullptr) && (result->type == ProcedureType);
 }
 
 Procedure Environment::get_proc(const Atom & sym) const{
 
   //Procedure proc = default_proc;
 
-  if(sym.isSymbol()){
-    auto result = envmap.find(sym.asSymbol());
-    if((result != envmap.end()) && (result->second.type == ProcedureType)){
-      return result->second.proc;
-    }
+  const EnvResult * result = find(sym);
+  if((result != nullptr) && (result->type == ProcedureType)){
+    return result->proc;
   }
 
-  return default_proc;
+  return Procedure(default_proc);
+}
+
+Procedure Environment::get_proc(const Atom & sym, CallSiteCache & cache) const{
+
+  if(!sym.isSymbol()){
+    return nullptr;
+  }
+
+  SymbolTable::IdType id = sym.symbolId();
+  std::uint64_t bit = std::uint64_t(1) << (id & 63);
+
+  // the cache only applies to a procedure bound at the top level and not
+  // possibly shadowed by a frame
+  const Environment * top = this;
+  bool shadowed = false;
+  while(top->parent != nullptr){
+    shadowed = shadowed || (top->mask & bit);
+    top = top->parent;
+  }
+
+  if(!shadowed && (cache.version == top->version) && (cache.symbol == id)){
+    return cache.proc;
+  }
+
+  const EnvResult * result = find(sym);
+  if((result == nullptr) || (result->type != ProcedureType)){
+    return nullptr;
+  }
+
+  if(!shadowed){
+    cache.version = top->version;
+    cache.symbol = id;
+    cache.proc = result->proc;
+  }
+
+  return result->proc;
 }
 
 void Environment::add_replace(const Atom & sym, const Expression & exp)
 {
-  if (envmap.find(sym.asSymbol()) != envmap.end())
-  {
-    envmap.erase(sym.asSymbol());
-  }
   add_exp(sym, exp);
 }
 
+void Environment::add_builtin(const std::string & name, const EnvResult & result)
+{
+  // as with emplace, the first binding of a name wins
+  std::size_t before = count;
+  EnvResult & slot = insert(SymbolTable::intern(name));
+  if(count != before){
+    slot = result;
+  }
+}
+
 /*
 Reset the environment to the default state. First remove all entries and
 then re-add the default ones.
  */
 void Environment::reset(){
 
-  envmap.clear();
+  table.clear();
+  count = 0;
+  params.clear();
+  mask = 0;
+  parent = nullptr;
+  touch();
 
   // Built-In value of pi
-  envmap.emplace("pi", EnvResult(ExpressionType, Expression(PI)));
+  add_builtin("pi", EnvResult(ExpressionType, Expression(PI)));
 
   // Procedure: add;
-  envmap.emplace("+", EnvResult(ProcedureType, add));
+  add_builtin("+", EnvResult(ProcedureType, Procedure(add).elementwise(&ADD_KERNEL)));
 
   // Procedure: subneg;
-  envmap.emplace("-", EnvResult(ProcedureType, subneg));
+  add_builtin("-", EnvResult(ProcedureType, Procedure(subneg, 1, 2,
+    "Error in call to subtraction or negation: invalid number of arguments.").elementwise(&SUBNEG_KERNEL)));
 
   // Procedure: mul;
-  envmap.emplace("*", EnvResult(ProcedureType, mul));
+  add_builtin("*", EnvResult(ProcedureType, Procedure(mul).elementwise(&MUL_KERNEL)));
 
   // Procedure: div;
-  envmap.emplace("/", EnvResult(ProcedureType, div));
+  add_builtin("/", EnvResult(ProcedureType, Procedure(div, 1, 2,
+    "Error in call to division: invalid number of arguments.").elementwise(&DIV_KERNEL)));
 
   //Procedure: sqrt;
-  envmap.emplace("sqrt", EnvResult(ProcedureType, squareroot));
+  add_builtin("sqrt", EnvResult(ProcedureType, Procedure(squareroot, 1, 1,
+    "Error in call to exponential: invalid number of arguments.").elementwise(&SQRT_KERNEL)));
 
   //Procedure: exp;
-  envmap.emplace("^", EnvResult(ProcedureType, exponential));
+  add_builtin("^", EnvResult(ProcedureType, Procedure(exponential, 2, 2,
+    "Error in call to exponential: invalid number of arguments.").elementwise(&EXP_KERNEL)));
 
   //Procedure: ln;
-  envmap.emplace("ln", EnvResult(ProcedureType, naturalLog));
+  add_builtin("ln", EnvResult(ProcedureType, Procedure(naturalLog, 0, 1,
+    "Error in call to naturalLog, too many arguments",
+    Procedure::NumberKind, "Error in call to naturalLog, argument not a number").elementwise(&LN_KERNEL)));
 
   //Procedure: sine;
-  envmap.emplace("sin", EnvResult(ProcedureType, sine));
+  add_builtin("sin", EnvResult(ProcedureType, Procedure(sine, 0, 1,
+    "Error in call to sine, too many arguments",
+    Procedure::NumberKind, "Error in call to sine, argument not a number").elementwise(&SIN_KERNEL)));
 
   //Procedure: cosine;
-  envmap.emplace("cos", EnvResult(ProcedureType, cosine));
+  add_builtin("cos", EnvResult(ProcedureType, Procedure(cosine, 0, 1,
+    "Error in call to cosine, too many arguments",
+    Procedure::NumberKind, "Error in call to cosine, argument not a number").elementwise(&COS_KERNEL)));
 
   //Procedure: tangent;
-  envmap.emplace("tan", EnvResult(ProcedureType, tangent));
+  add_builtin("tan", EnvResult(ProcedureType, Procedure(tangent, 0, 1,
+    "Error in call to tangent, too many arguments",
+    Procedure::NumberKind, "Error in call to tangent, argument not a number").elementwise(&TAN_KERNEL)));
 
   //Built in value of e;
-  envmap.emplace("e", EnvResult(ExpressionType, Expression(EXP)));
+  add_builtin("e", EnvResult(ExpressionType, Expression(EXP)));
 
   //Built in value of I
-  envmap.emplace("I", EnvResult(ExpressionType, Expression(I)));
+  add_builtin("I", EnvResult(ExpressionType, Expression(I)));
 
   //Procedure: real;
-  envmap.emplace("real", EnvResult(ProcedureType, realComplex));
+  add_builtin("real", EnvResult(ProcedureType, Procedure(realComplex, 1, 1,
+    "Error in call to real: invalid number of arguments.",
+    Procedure::ComplexKind, "Error in call to real, argument not complex").elementwise()));
 
   //Procedure: imag;
-  envmap.emplace("imag", EnvResult(ProcedureType, imagComplex));
+  add_builtin("imag", EnvResult(ProcedureType, Procedure(imagComplex, 1, 1,
+    "Error in call to imaginary: invalid number of arguments.",
+    Procedure::ComplexKind, "Error in call to imaginary, argument not complex").elementwise()));
 
   //Procedure: mag;
-  envmap.emplace("mag", EnvResult(ProcedureType, magComplex));
+  add_builtin("mag", EnvResult(ProcedureType, Procedure(magComplex, 1, 1,
+    "Error in call to mag: invalid number of arguments.",
+    Procedure::ComplexKind, "Error in call to mag, argument not complex").elementwise()));
 
   //Procedure: arg;
-  envmap.emplace("arg", EnvResult(ProcedureType, argComplex));
+  add_builtin("arg", EnvResult(ProcedureType, Procedure(argComplex, 1, 1,
+    "Error in call to arg: invalid number of arguments.",
+    Procedure::ComplexKind, "Error in call to arg, argument not complex").elementwise()));
 
   //Procedure: conj;
-  envmap.emplace("conj", EnvResult(ProcedureType, conjComplex));
+  add_builtin("conj", EnvResult(ProcedureType, Procedure(conjComplex, 1, 1,
+    "Error in call to conj: invalid number of arguments.",
+    Procedure::ComplexKind, "Error in call to conj, argument not complex").elementwise()));
 
   //Procedure: list;
-  envmap.emplace("list", EnvResult(ProcedureType, list));
+  add_builtin("list", EnvResult(ProcedureType, Procedure(list)));
 
   //Expression list;
-  envmap.emplace("list", EnvResult(ExpressionType, Expression(LIST)));
+  add_builtin("list", EnvResult(ExpressionType, Expression(LIST)));
 
   //Procedure: first;
-  envmap.emplace("first", EnvResult(ProcedureType, first));
+  add_builtin("first", EnvResult(ProcedureType, Procedure(first, 1, 1,
+    "Error: more than one argument in call to first")));
 
   //Procedure: range;
-  envmap.emplace("range", EnvResult(ProcedureType, range));//working
+  add_builtin("range", EnvResult(ProcedureType, Procedure(range, 3, 3,
+    "Error: did not give 3 arguments",
+    Procedure::NumberKind, "Error: one of the arguments is not a number").sequence(rangeSequence)));//working
 
   //Procedure: rest;
-  envmap.emplace("rest", EnvResult(ProcedureType, rest));
+  add_builtin("rest", EnvResult(ProcedureType, Procedure(rest, 1, 1,
+    "Error: more than one argument in call to rest")));
 
   //Procedure: length;
-  envmap.emplace("length", EnvResult(ProcedureType, length));
+  add_builtin("length", EnvResult(ProcedureType, Procedure(length, 1, 1,
+    "Error: not enough or too many arguments in call to length",
+    Procedure::ListKind, "Error: argument to length is not a list")));
 
   //Procedure: append
-  envmap.emplace("append", EnvResult(ProcedureType, append));//working
+  add_builtin("append", EnvResult(ProcedureType, Procedure(append, 2, 2,
+    "Error: two arguments for append not given")));//working
 
   //Procedure: join
-  envmap.emplace("join", EnvResult(ProcedureType, join));//working
+  add_builtin("join", EnvResult(ProcedureType, Procedure(join, 2, 2,
+    "Error: two arguments for join not given",
+    Procedure::ListKind, "Error: argument to join not a list")));//working
 }
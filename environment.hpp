@@ -11,17 +11,207 @@ needed.
 #define ENVIRONMENT_HPP
 
 // system includes
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 // module includes
 #include "atom.hpp"
 #include "expression.hpp"
+#include "pool_allocator.hpp"
 
-/*! \typedef Procedure
-\brief A Procedure is a C++ function pointer taking a vector of
-       Expressions as arguments and returning an Expression.
+/*! \class ArgSpan
+\brief A read-only view of the arguments of a procedure call.
+
+The arguments stay where the caller evaluated them, usually on the value
+stack of the evaluator, so calling a procedure neither copies them nor
+allocates.
 */
-typedef Expression (*Procedure)(const std::vector<Expression> & args);
+class ArgSpan {
+public:
+
+  typedef const Expression * ConstIteratorType;
+
+  /// view size arguments starting at first
+  ArgSpan(const Expression * first, std::size_t size) noexcept: first(first), count(size){}
+
+  /// view every element of args
+  ArgSpan(const std::vector<Expression> & args) noexcept: first(args.data()), count(args.size()){}
+
+  /// the number of arguments
+  std::size_t size() const noexcept { return count; }
+
+  /// true if there are no arguments
+  bool empty() const noexcept { return count == 0; }
+
+  /// return a const-reference to the argument at index
+  const Expression & operator[](std::size_t index) const noexcept { return first[index]; }
+
+  /// return a const-iterator to the first argument
+  ConstIteratorType begin() const noexcept { return first; }
+
+  /// return a const-iterator past the last argument
+  ConstIteratorType end() const noexcept { return first + count; }
+
+private:
+  const Expression * first;
+  std::size_t count;
+};
+
+/*! \class Procedure
+\brief A built-in procedure: the C++ function implementing it, and the
+number and kind of arguments it accepts.
+
+Calling a Procedure checks its arguments against this description first,
+throwing a SemanticError with the procedure's own message on a mismatch,
+so the function is only ever called with arguments that pass the checks.
+A default constructed Procedure, equal to nullptr, names no procedure.
+
+An element-wise procedure called with lists is applied to their elements
+in turn, repeating any argument that is not a list, and returns the list
+of results. Given a Kernel, it computes packed lists of numbers with loops
+over whole arrays instead, which the compiler can vectorize.
+
+A procedure that builds an arithmetic sequence can describe it without
+building it, so that a consumer such as map can generate its elements.
+*/
+class Procedure {
+public:
+
+  /// the kind every argument must be
+  enum ArgKind : std::uint8_t { AnyKind,     //< no requirement
+                                NumberKind,  //< a real number
+                                ComplexKind, //< a complex number
+                                ListKind     //< a list
+  };
+
+  /// the signature of the function implementing a procedure
+  typedef Expression (*Function)(ArgSpan args);
+
+  /// a maximum number of arguments meaning there is no maximum
+  static const std::size_t VARIADIC = static_cast<std::size_t>(-1);
+
+  /*! \struct Kernel
+    \brief The loops computing an element-wise procedure over arrays of n numbers.
+
+    Any loop may be nullptr if the procedure takes no such arguments.
+   */
+  struct Kernel {
+    /// out[i] = f(a[i]), returning false if some result is not a real number
+    bool (*unary)(const double * a, double * out, std::size_t n);
+    /// out[i] = f(a[i], b[i])
+    void (*binary)(const double * a, const double * b, double * out, std::size_t n);
+    /// out[i] = f(a, b[i])
+    void (*left)(double a, const double * b, double * out, std::size_t n);
+    /// out[i] = f(a[i], b)
+    void (*right)(const double * a, double b, double * out, std::size_t n);
+  };
+
+  /// construct a Procedure naming no procedure
+  Procedure(std::nullptr_t = nullptr) noexcept;
+
+  /*! Construct a Procedure.
+    \param function the function implementing it
+    \param min_args the least number of arguments accepted
+    \param max_args the most number of arguments accepted, or VARIADIC
+    \param arity_error the message when the number of arguments is wrong
+    \param kind the kind every argument must be
+    \param kind_error the message when an argument is of the wrong kind
+   */
+  Procedure(Function function, std::size_t min_args = 0, std::size_t max_args = VARIADIC,
+            const char * arity_error = nullptr,
+            ArgKind kind = AnyKind, const char * kind_error = nullptr) noexcept;
+
+  /*! \struct Sequence
+    \brief The numbers begin, begin + step, ... up to and including end,
+    each found by adding step to the one before.
+   */
+  struct Sequence {
+    double begin;
+    double end;
+    double step;
+
+    /// the number of elements worth making room for ahead of time, which is
+    /// bounded, so a huge sequence only grows as it is built
+    std::size_t size_hint() const noexcept;
+  };
+
+  /// the signature of a function describing the sequence a procedure builds
+  typedef Sequence (*Sequencer)(ArgSpan args);
+
+  /*! Make the procedure describe the sequence it builds.
+    \param sequencer the function describing it, which raises the same errors
+    \return this procedure
+   */
+  Procedure & sequence(Sequencer sequencer) noexcept;
+
+  /// true if the procedure can describe the sequence it builds
+  bool is_sequence() const noexcept { return sequencer != nullptr; }
+
+  /*! Check the arguments and describe the sequence they would build.
+    \param args the arguments, as for a call
+    \return the sequence
+    \throws SemanticError as a call would
+   */
+  Sequence describe(ArgSpan args) const;
+
+  /*! Make the procedure element-wise.
+    \param kernel the loops computing it over packed lists, or nullptr
+    \return this procedure
+   */
+  Procedure & elementwise(const Kernel * kernel = nullptr) noexcept;
+
+  /// check the arguments and call the procedure with them
+  Expression operator()(ArgSpan args) const{
+    if((args.size() < min_args) || (args.size() > max_args)){
+      fail(arity_error);
+    }
+    if(broadcasts){
+      for(const Expression & a : args){
+        if(a.isHeadList()){
+          return broadcast(args);
+        }
+      }
+    }
+    if(kind != AnyKind){
+      for(const Expression & a : args){
+        if(!is_kind(a)){
+          fail(kind_error);
+        }
+      }
+    }
+    return function(args);
+  }
+
+  /// true if both name the same function
+  bool operator==(const Procedure & p) const noexcept { return function == p.function; }
+
+  /// true if the two name different functions
+  bool operator!=(const Procedure & p) const noexcept { return function != p.function; }
+
+private:
+  Function function;
+  std::size_t min_args;
+  std::size_t max_args;
+  const char * arity_error;
+  ArgKind kind;
+  const char * kind_error;
+  bool broadcasts;
+  const Kernel * kernel;
+  Sequencer sequencer;
+
+  // true if a is of the required kind
+  bool is_kind(const Expression & a) const noexcept;
+
+  // apply an element-wise procedure to the elements of the lists in args
+  Expression broadcast(ArgSpan args) const;
+
+  // compute broadcast with the kernel, returning false if it cannot
+  bool broadcast_packed(ArgSpan args, std::size_t length, std::vector<double> & out) const;
+
+  // throw a SemanticError with message
+  [[noreturn]] static void fail(const char * message);
+};
 
 /*! \class Environment
 \brief A class representing the interpreter environment.
@@ -36,13 +226,49 @@ return you can obtain
 the mapped-to value using get_exp or get_proc.
 
 To add an symbol to expression mapping use the add_exp member function.
+
+Call sites may cache the built-in procedure they resolve to, see
+CallSiteCache. The cache stays valid until the top level is modified.
+
+Bindings are kept in an open-addressing hash table keyed on the interned id
+of each symbol, so a lookup is O(1) and never compares names.
+
+The parameters of a lambda call are also kept in order, so a reference
+that the parser resolved to a parameter position reads its argument directly.
+
+An environment may be a frame chained to a parent environment. A frame holds
+only the symbols added to it; lookups that miss the frame fall through to the
+parent, while additions always go to the frame itself. Lambda calls evaluate
+their body in such a frame, so the cost of a call does not depend on the size
+of the enclosing environment.
  */
 class Environment {
 public:
+
+  /*! \struct CallSiteCache
+    \brief The procedure a call site last resolved to, the name it resolved,
+    and the version of the top-level environment it was resolved in.
+
+    The name is checked too, since call site numbers are reused.
+   */
+  struct CallSiteCache {
+    std::uint64_t version;
+    SymbolTable::IdType symbol;
+    Procedure proc;
+
+    CallSiteCache(): version(0), symbol(0), proc(nullptr){};
+  };
+
   /*! Construct the default environment with built-in procedures and
    * definitions. */
   Environment();
 
+  /*! Construct an empty frame chained to a parent environment.
+    \param parent the environment lookups fall through to, which must
+    outlive this frame
+   */
+  explicit Environment(const Environment * parent);
+
   //copy constructor
   Environment(const Environment & env);
 
@@ -61,9 +287,32 @@ public:
 
   /*! Get the Expression the argument symbol maps to.
     \param sym the symbol to lookup
-    \return the expression the symbol maps to or an Expression of NoneType
+    \return the expression the symbol maps to or an Expression of NoneType.
+    The reference is valid until the environment is next modified.
   */
-  Expression get_exp(const Atom &sym) const;
+  const Expression & get_exp(const Atom &sym) const;
+
+  /*! Look up a symbol, probing each frame once.
+    \param sym the symbol to lookup
+    \return a pointer to the expression the symbol maps to, to an Expression
+    of NoneType if it maps to a procedure, or nullptr if it is unknown
+   */
+  const Expression * lookup(const Atom &sym) const;
+
+  /*! Get a lambda parameter bound in this frame by its position.
+    \param index the position of the parameter in the parameter list
+    \param id the interned name of the parameter
+    \return the argument bound to the parameter, or nullptr if parameter
+    index of this frame is not named id
+   */
+  const Expression * get_param(std::size_t index, SymbolTable::IdType id) const noexcept;
+
+  /*! Bind a lambda parameter in this frame, replacing any previous binding.
+    \param index the position of the parameter in the parameter list
+    \param sym the name of the parameter
+    \param exp the argument
+   */
+  void bind_param(std::size_t index, const Atom &sym, const Expression &exp);
 
   /*! Add a mapping from sym argument to the exp argument within the environment.
     \param sym the symbol to add
@@ -86,7 +335,21 @@ public:
   */
   Procedure get_proc(const Atom &sym) const;
 
-  /*! Reset the environment to its default state. */
+  /*! Get the Procedure the argument symbol maps to, through the cache of
+    a call site.
+    \param sym the symbol to lookup
+    \param cache the cache of the call site, refreshed when out of date
+    \return the procedure it maps to, or nullptr if it does not map to a
+    procedure
+
+    The cache is used while no frame between this environment and the top
+    level binds sym and the top level has not been modified since the cache
+    was filled.
+  */
+  Procedure get_proc(const Atom &sym, CallSiteCache &cache) const;
+
+  /*! Reset the environment to its default state, detaching it from any
+    parent. */
   void reset();
 
   void add_replace(const Atom & sym, const Expression & exp);
@@ -103,12 +366,58 @@ private:
 
     // constructors for use in container emplace
     EnvResult(){};
-    EnvResult(EnvResultType t, Expression e) : type(t), exp(e){};
+    EnvResult(EnvResultType t, Expression e) : type(t), exp(std::move(e)){};
     EnvResult(EnvResultType t, Procedure p) : type(t), proc(p){};
   };
 
-  // the environment map
-  std::map<std::string, EnvResult> envmap;
+  // a slot of the hash table, unused while key is EMPTY_KEY
+  struct Slot {
+    SymbolTable::IdType key;
+    EnvResult result;
+
+    Slot(): key(EMPTY_KEY){};
+  };
+
+  static const SymbolTable::IdType EMPTY_KEY = static_cast<SymbolTable::IdType>(-1);
+
+  // the hash table, with a power of two size, or empty for a frame with no
+  // bindings. It comes from a pool, since lambda calls create and destroy
+  // frames often.
+  std::vector<Slot, PoolAllocator<Slot>> table;
+
+  // the number of used slots
+  std::size_t count;
+
+  // the parameters of a lambda call, in parameter list order, so that
+  // references resolved by the parser can read them by position. They are
+  // searched before the table and never also bound in it.
+  std::vector<Slot, PoolAllocator<Slot>> params;
+
+  // bit (id % 64) is set for the id of every binding in this frame, so that
+  // lookups can skip frames that certainly do not bind a symbol
+  std::uint64_t mask;
+
+  // the enclosing environment, or nullptr at the top level
+  const Environment * parent;
+
+  // a stamp unique among all environments, renewed whenever a binding of a
+  // top-level environment changes, which invalidates call site caches
+  std::uint64_t version;
+
+  // renew version if this is a top-level environment
+  void touch() noexcept;
+
+  // find the innermost binding of sym, or nullptr if it is unbound
+  const EnvResult * find(const Atom & sym) const;
+
+  // find the binding of id in this frame, or nullptr
+  const EnvResult * find_local(SymbolTable::IdType id) const;
+
+  // return the binding of id in this frame, adding an empty one if needed
+  EnvResult & insert(SymbolTable::IdType id);
+
+  // helper to bind a built-in name during reset
+  void add_builtin(const std::string & name, const EnvResult & result);
 };
 
 #endif
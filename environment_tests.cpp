@@ -93,3 +93,151 @@ TEST_CASE( "Test semeantic errors", "[environment]" ) {
   }
 }
 
+
+TEST_CASE( "Test chained environment frames", "[environment]" ) {
+
+  Environment env;
+  env.add_exp(Atom("a"), Expression(1));
+
+  Environment frame(&env);
+
+  // lookups fall through to the parent
+  REQUIRE(frame.is_exp(Atom("a")));
+  REQUIRE(frame.get_exp(Atom("a")) == Expression(1));
+  REQUIRE(frame.is_proc(Atom("+")));
+
+  // additions stay in the frame and shadow the parent
+  frame.add_exp(Atom("a"), Expression(2));
+  frame.add_exp(Atom("+"), Expression(3));
+  frame.add_exp(Atom("b"), Expression(4));
+  REQUIRE(frame.get_exp(Atom("a")) == Expression(2));
+  REQUIRE(frame.is_exp(Atom("+")));
+  REQUIRE(!frame.is_proc(Atom("+")));
+
+  REQUIRE(env.get_exp(Atom("a")) == Expression(1));
+  REQUIRE(env.is_proc(Atom("+")));
+  REQUIRE(!env.is_known(Atom("b")));
+}
+
+TEST_CASE( "Test many bindings in one frame", "[environment]" ) {
+
+  Environment env;
+  Environment frame(&env);
+
+  // enough bindings to grow the table several times
+  for(int i = 0; i < 500; ++i){
+    frame.add_exp(Atom("v" + std::to_string(i)), Expression(i));
+  }
+  for(int i = 0; i < 500; ++i){
+    REQUIRE(frame.get_exp(Atom("v" + std::to_string(i))) == Expression(i));
+  }
+
+  // rebinding replaces in place
+  frame.add_exp(Atom("v7"), Expression(-7));
+  REQUIRE(frame.get_exp(Atom("v7")) == Expression(-7));
+
+  // the parent is still visible and untouched
+  REQUIRE(frame.is_proc(Atom("+")));
+  REQUIRE(!env.is_known(Atom("v7")));
+
+  // a copy owns its own table
+  Environment copy(frame);
+  copy.add_exp(Atom("v8"), Expression(0));
+  REQUIRE(frame.get_exp(Atom("v8")) == Expression(8));
+  REQUIRE(copy.get_exp(Atom("v8")) == Expression(0));
+}
+
+TEST_CASE( "Test call site caches", "[environment]" ) {
+
+  Environment env;
+  Environment::CallSiteCache cache;
+
+  Procedure add = env.get_proc(Atom("+"));
+  REQUIRE(env.get_proc(Atom("+"), cache) == add);
+  REQUIRE(cache.proc == add);
+
+  // a frame that shadows the name bypasses the cache
+  Environment frame(&env);
+  frame.add_exp(Atom("+"), Expression(1));
+  REQUIRE(frame.get_proc(Atom("+"), cache) == nullptr);
+  REQUIRE(env.get_proc(Atom("+"), cache) == add);
+
+  // a frame that does not is served from it
+  Environment other(&env);
+  REQUIRE(other.get_proc(Atom("+"), cache) == add);
+
+  // redefining the name at the top level invalidates it
+  env.add_exp(Atom("+"), Expression(1));
+  REQUIRE(other.get_proc(Atom("+"), cache) == nullptr);
+  REQUIRE(env.get_proc(Atom("-"), cache) == env.get_proc(Atom("-")));
+
+  // a different environment does not share it
+  Environment env2;
+  env2.add_exp(Atom("-"), Expression(1));
+  REQUIRE(env2.get_proc(Atom("-"), cache) == nullptr);
+
+  // a cache filled for one name is not used for another, as call site
+  // numbers are reused
+  Environment env3;
+  Environment::CallSiteCache reused;
+  REQUIRE(env3.get_proc(Atom("+"), reused) == env3.get_proc(Atom("+")));
+  REQUIRE(env3.get_proc(Atom("*"), reused) == env3.get_proc(Atom("*")));
+  REQUIRE(env3.get_proc(Atom("+"), reused) != env3.get_proc(Atom("*")));
+}
+
+TEST_CASE( "Test procedures check their arguments", "[environment]" ) {
+
+  Environment env;
+
+  std::vector<Expression> args = {Expression(1), Expression(2), Expression(3)};
+
+  // procedures read a view of the arguments
+  Procedure padd = env.get_proc(Atom("+"));
+  REQUIRE(padd(ArgSpan(args.data(), 2)) == Expression(3.0));
+  REQUIRE(padd(ArgSpan(args.data() + 1, 2)) == Expression(5.0));
+
+  // the number of arguments is checked before the procedure runs
+  Procedure psin = env.get_proc(Atom("sin"));
+  REQUIRE_THROWS_AS(psin(args), SemanticError);
+  REQUIRE_THROWS_AS(env.get_proc(Atom("range"))(ArgSpan(args.data(), 2)), SemanticError);
+
+  // and so is the kind of each argument
+  std::vector<Expression> lists = {Expression(args), Expression(1)};
+  Procedure pjoin = env.get_proc(Atom("join"));
+  REQUIRE_THROWS_AS(pjoin(lists), SemanticError);
+  lists[1] = Expression(args);
+  REQUIRE(pjoin(lists).tailSize() == 6);
+
+  REQUIRE(Procedure() == nullptr);
+  REQUIRE(padd != nullptr);
+  REQUIRE(padd != psin);
+}
+
+TEST_CASE( "Test element-wise procedures broadcast over lists", "[environment]" ) {
+
+  Environment env;
+
+  std::vector<Expression> numbers = {Expression(1), Expression(2), Expression(3)};
+  std::vector<Expression> args = {Expression(numbers), Expression(10)};
+
+  Procedure padd = env.get_proc(Atom("+"));
+  Expression sum = padd(args);
+  REQUIRE(sum.isHeadList());
+  REQUIRE(sum.tailSize() == 3);
+  REQUIRE(sum.getTail(2) == Expression(13));
+
+  // a procedure that is not element-wise still checks its arguments
+  Procedure pfirst = env.get_proc(Atom("first"));
+  REQUIRE_THROWS_AS(pfirst(args), SemanticError);
+}
+
+TEST_CASE( "Test the room made for a sequence is bounded", "[environment]" ) {
+
+  REQUIRE((Procedure::Sequence{0, 10, 1}.size_hint()) == 11);
+  REQUIRE((Procedure::Sequence{0, 1, 0.25}.size_hint()) == 5);
+
+  // a count too large to convert, or to make room for at once
+  REQUIRE((Procedure::Sequence{0, 1e300, 1e-300}.size_hint()) == (std::size_t(1) << 20));
+  REQUIRE((Procedure::Sequence{0, 1e14, 1}.size_hint()) == (std::size_t(1) << 20));
+  REQUIRE((Procedure::Sequence{0, std::nan(""), 1}.size_hint()) == 0);
+}
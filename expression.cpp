@@ -1,6 +1,7 @@
 #include "expression.hpp"
 #include "consumer.hpp"
 
+#include <algorithm>
 #include <sstream>
 #include <list>
 #include <complex>
@@ -9,6 +10,7 @@
 #include <cmath>
 #include <math.h>
 #include <atomic>
+#include <memory>
 
 
 using std::endl;
@@ -19,71 +21,243 @@ using std::cout;
 
 volatile sig_atomic_t global_status_flag = 0;
 
-Expression::Expression(){}
+// interned keys of the properties set by the plot forms
+static const SymbolTable::IdType OBJECT_NAME_PROPERTY = SymbolTable::intern("\"object-name\"");
+static const SymbolTable::IdType POSITION_PROPERTY = SymbolTable::intern("\"position\"");
+static const SymbolTable::IdType ROTATION_PROPERTY = SymbolTable::intern("\"rotation\"");
+static const SymbolTable::IdType SCALE_PROPERTY = SymbolTable::intern("\"scale\"");
+static const SymbolTable::IdType SIZE_PROPERTY = SymbolTable::intern("\"size\"");
+static const SymbolTable::IdType THICKNESS_PROPERTY = SymbolTable::intern("\"thickness\"");
+
+void ExpressionTail::expand() const{
+
+  // the elements are built by the first reader, the others wait for it
+  std::call_once(expanded, [this](){
+    ExpressionTail & elements = const_cast<ExpressionTail &>(*this);
+    elements.reserve(numbers.size());
+    for(double d : numbers){
+      elements.emplace_back(Atom(d));
+    }
+  });
+}
 
-Expression::Expression(const Atom & a){
-  m_head = a;
+template<>
+const ExpressionTail & CopyOnWrite<ExpressionTail>::get() const noexcept
+{
+  if (!data)
+  {
+    return empty_container();
+  }
+  if (!data->numbers.empty())
+  {
+    data->expand();
+  }
+  return *data;
 }
 
+template<>
+ExpressionTail & CopyOnWrite<ExpressionTail>::edit()
+{
+  if (!data)
+  {
+    data = std::allocate_shared<ExpressionTail>(PoolAllocator<ExpressionTail>());
+  }
+  else if (!data->numbers.empty())
+  {
+    // a packed tail is replaced by one holding only its elements
+    std::shared_ptr<ExpressionTail> elements = std::allocate_shared<ExpressionTail>(PoolAllocator<ExpressionTail>());
+    elements->reserve(data->numbers.size());
+    for(double d : data->numbers){
+      elements->emplace_back(Atom(d));
+    }
+    data = std::move(elements);
+  }
+  else if (data.use_count() > 1)
+  {
+    std::shared_ptr<ExpressionTail> elements = std::allocate_shared<ExpressionTail>(PoolAllocator<ExpressionTail>());
+    static_cast<std::vector<Expression> &>(*elements) = *data;
+    data = std::move(elements);
+  }
+  return *data;
+}
+
+template<>
+CopyOnWrite<ExpressionTail>::size_type CopyOnWrite<ExpressionTail>::size() const noexcept
+{
+  if (!data)
+  {
+    return 0;
+  }
+  return data->numbers.empty() ? data->size() : data->numbers.size();
+}
+
+template<>
+bool CopyOnWrite<ExpressionTail>::empty() const noexcept
+{
+  return !data || (data->empty() && data->numbers.empty());
+}
+
+Expression::Expression(): m_form(UnresolvedForm), m_slot(NO_SLOT){}
+
+Expression::Expression(const Atom & a): m_head(a), m_form(UnresolvedForm), m_slot(NO_SLOT){}
+
 int Expression::tailSize() const noexcept
 {
   return m_tail.size();//helper to get tail size
 }
 
-Expression Expression::getExpressionFirst() const noexcept //helper to get the frist eleemnt of m_tail
+const Expression & Expression::getExpressionFirst() const noexcept //helper to get the frist eleemnt of m_tail
 {
   return m_tail[0];
 }
 
-Expression Expression::getTail(int location) const noexcept
+const Expression & Expression::getTail(int location) const noexcept
 {
   return m_tail[location];
 }
 
-Expression::Expression(const std::vector<Expression> & a)//create a vector of expressions
+Expression::~Expression(){
+
+  if(!m_tail.unique()){
+    return;
+  }
+
+  // the default destructor recurses once per level, which is only a
+  // problem when some element has a tail of its own
+  bool nested = false;
+  for(auto & e : m_tail){
+    if(e.m_tail.unique()){
+      nested = true;
+      break;
+    }
+  }
+  if(!nested){
+    return;
+  }
+
+  // otherwise flatten the tree into a work list, destroying one node at a time
+  std::vector<Expression> pending;
+  std::vector<Expression> & tail = m_tail.edit();
+  pending.insert(pending.end(), std::make_move_iterator(tail.begin()), std::make_move_iterator(tail.end()));
+  tail.clear();
+
+  while(!pending.empty()){
+    Expression e(std::move(pending.back()));
+    pending.pop_back();
+
+    if(e.m_tail.unique()){
+      std::vector<Expression> & t = e.m_tail.edit();
+      pending.insert(pending.end(), std::make_move_iterator(t.begin()), std::make_move_iterator(t.end()));
+      t.clear();
+    }
+  }
+}
+
+Expression::Expression(const std::vector<Expression> & a): m_form(UnresolvedForm), m_slot(NO_SLOT)//create a vector of expressions
 {
   m_head.setList();//set the listkind
-  for(auto & e : a)
+  if (!a.empty() && !pack(a))
   {
-    m_tail.push_back(e);//push the elements back
+    m_tail.edit() = a;//copies of the elements share their own tails
   }
 }
 
-// recursive copy
-Expression::Expression(const Expression & a){
-  m_head = a.m_head;
-  prop = a.prop;
-  for(auto e : a.m_tail){
-    m_tail.push_back(e);
+Expression::Expression(std::vector<Expression> && a): m_form(UnresolvedForm), m_slot(NO_SLOT)
+{
+  m_head.setList();
+  if (!a.empty() && !pack(a))
+  {
+    m_tail.edit() = std::move(a);
   }
 }
 
+Expression::Expression(std::vector<double> && numbers): m_form(UnresolvedForm), m_slot(NO_SLOT)
+{
+  m_head.setList();
+  if (numbers.size() >= PACKED_SIZE)
+  {
+    m_tail.edit().numbers = std::move(numbers);
+  }
+  else if (!numbers.empty())
+  {
+    ExpressionTail & tail = m_tail.edit();
+    tail.reserve(numbers.size());
+    for(double d : numbers){
+      tail.emplace_back(Atom(d));
+    }
+  }
+}
+
+bool Expression::pack(const std::vector<Expression> & a){
+
+  if(a.size() < PACKED_SIZE){
+    return false;
+  }
+
+  // only numbers without a tail or properties of their own can be packed
+  for(const Expression & e : a){
+    if(!e.isHeadNumber() || !e.m_tail.empty() || !e.prop.empty()){
+      return false;
+    }
+  }
+
+  std::vector<double> & numbers = m_tail.edit().numbers;
+  numbers.reserve(a.size());
+  for(const Expression & e : a){
+    numbers.push_back(e.m_head.asNumber());
+  }
+  return true;
+}
+
+bool Expression::isPackedList() const noexcept{
+
+  const ExpressionTail * tail = m_tail.stored();
+  return (tail != nullptr) && !tail->numbers.empty();
+}
+
+const std::vector<double> & Expression::packedNumbers() const noexcept{
+
+  static const std::vector<double> none;
+  const ExpressionTail * tail = m_tail.stored();
+  return (tail != nullptr) ? tail->numbers : none;
+}
+
+// shallow copy, the tail and properties are shared until modified
+Expression::Expression(const Expression & a): m_head(a.m_head), m_tail(a.m_tail), m_form(a.m_form), m_slot(a.m_slot), prop(a.prop){}
+
 Expression & Expression::operator=(const Expression & a){
 
   // prevent self-assignment
   if(this != &a){
     m_head = a.m_head;
     prop = a.prop;
-    m_tail.clear();
-    for(auto e : a.m_tail){
-      m_tail.push_back(e);
-    }
+    m_tail = a.m_tail;
+    m_form = a.m_form;
+    m_slot = a.m_slot;
   }
   return *this;
 }
 
+Expression::Expression(Expression && a) noexcept: m_head(std::move(a.m_head)), m_tail(std::move(a.m_tail)), m_form(a.m_form), m_slot(a.m_slot), prop(std::move(a.prop)){}
 
-Atom & Expression::head(){
-  return m_head;
+Expression & Expression::operator=(Expression && a) noexcept{
+
+  if(this != &a){
+    m_head = std::move(a.m_head);
+    m_tail = std::move(a.m_tail);
+    m_form = a.m_form;
+    m_slot = a.m_slot;
+    prop = std::move(a.prop);
+  }
+  return *this;
 }
 
-const Atom & Expression::head() const{
+
+Atom & Expression::head(){
   return m_head;
 }
 
-bool Expression::isHeadNumber() const noexcept{
-  return m_head.isNumber();
-}
+
 
 bool Expression::isHeadSymbol() const noexcept{
   return m_head.isSymbol();
@@ -93,10 +267,6 @@ bool Expression::isHeadComplex() const noexcept{
   return m_head.isComplex();//check if complex
 }
 
-bool Expression::isHeadList() const noexcept{
-  return m_head.isList();//check if list
-}
-
 bool Expression::isHeadNone() const noexcept
 {
   return m_head.isNone();
@@ -106,6 +276,17 @@ void Expression::append(const Atom & a){
   m_tail.emplace_back(a);
 }
 
+void Expression::append(std::vector<Expression> && a){
+
+  std::vector<Expression> & tail = m_tail.edit();
+  if(tail.empty()){
+    tail = std::move(a);
+  }
+  else{
+    tail.insert(tail.end(), std::make_move_iterator(a.begin()), std::make_move_iterator(a.end()));
+  }
+}
+
 
 Expression * Expression::tail(){
   Expression * ptr = nullptr;
@@ -117,6 +298,163 @@ Expression * Expression::tail(){
   return ptr;
 }
 
+// map a head atom to the special-form it names
+Expression::Form form_of(const Atom & head) noexcept{
+
+  if(!head.isSymbol()){
+    return Expression::CallForm;
+  }
+
+  static const std::pair<SymbolTable::IdType, Expression::Form> forms[] = {
+    {SymbolTable::intern("list"), Expression::ListForm},
+    {SymbolTable::intern("begin"), Expression::BeginForm},
+    {SymbolTable::intern("define"), Expression::DefineForm},
+    {SymbolTable::intern("lambda"), Expression::LambdaForm},
+    {SymbolTable::intern("apply"), Expression::ApplyForm},
+    {SymbolTable::intern("map"), Expression::MapForm},
+    {SymbolTable::intern("set-property"), Expression::SetPropertyForm},
+    {SymbolTable::intern("get-property"), Expression::GetPropertyForm},
+    {SymbolTable::intern("discrete-plot"), Expression::DiscretePlotForm},
+    {SymbolTable::intern("continuous-plot"), Expression::ContinuousPlotForm}
+  };
+
+  for(auto & f : forms){
+    if(f.first == head.symbolId()){
+      return f.second;
+    }
+  }
+  return Expression::CallForm;
+}
+
+void Expression::resolveForm() noexcept{
+  m_form = form_of(m_head);
+}
+
+Expression::Form Expression::form() const noexcept{
+  return (m_form != UnresolvedForm) ? m_form : form_of(m_head);
+}
+
+// the call site numbers, handed out lowest first and taken back when the
+// tail holding one is destroyed. The caches of call sites are kept per
+// thread in a table indexed by this number, so the numbering stops, leaving
+// further calls uncached, before that table could grow too large.
+namespace {
+struct CallSiteNumbers {
+  std::mutex mutex;
+  std::vector<std::uint32_t> released;
+  std::uint32_t next = 0;
+};
+
+CallSiteNumbers & call_site_numbers(){
+  // tails may be destroyed during program shutdown, so never destroyed
+  static CallSiteNumbers * numbers = new CallSiteNumbers();
+  return *numbers;
+}
+}
+
+static std::uint32_t acquire_call_site(){
+
+  const std::uint32_t MAX_CALL_SITES = std::uint32_t(1) << 20;
+
+  CallSiteNumbers & numbers = call_site_numbers();
+  std::lock_guard<std::mutex> lock(numbers.mutex);
+  if(!numbers.released.empty()){
+    std::uint32_t site = numbers.released.back();
+    numbers.released.pop_back();
+    return site;
+  }
+  if(numbers.next < MAX_CALL_SITES){
+    return numbers.next++;
+  }
+  return ExpressionTail::NO_SITE;
+}
+
+ExpressionTail::~ExpressionTail(){
+  if(site != NO_SITE){
+    CallSiteNumbers & numbers = call_site_numbers();
+    std::lock_guard<std::mutex> lock(numbers.mutex);
+    numbers.released.push_back(site);
+  }
+}
+
+void Expression::resolveReferences() noexcept{
+
+  // the parameters of the innermost enclosing lambda-form, indexed by
+  // position, with a repeated name resolving to its first position as
+  // binding it again replaces that binding
+  typedef std::vector<SymbolTable::IdType> Scope;
+  std::vector<Scope> scopes;
+
+  // stands in for a parameter that is not a symbol, which is never bound
+  const SymbolTable::IdType NOT_A_PARAM = static_cast<SymbolTable::IdType>(-1);
+
+  // expressions still to visit with the index of their scope, or -1 outside
+  // of any lambda-form. The walk is iterative so deep trees do not exhaust
+  // the stack.
+  std::vector<std::pair<Expression *, int>> pending;
+  pending.emplace_back(this, -1);
+
+  while(!pending.empty()){
+    Expression & exp = *pending.back().first;
+    int scope = pending.back().second;
+    pending.pop_back();
+
+    if(exp.m_tail.empty()){
+      exp.m_slot = NO_SLOT;
+      if((scope >= 0) && exp.m_head.isSymbol()){
+        const Scope & params = scopes[scope];
+        for(std::size_t i = 0; i < params.size(); ++i){
+          if(params[i] == exp.m_head.symbolId()){
+            exp.m_slot = static_cast<std::uint16_t>(i);
+            break;
+          }
+        }
+      }
+      continue;
+    }
+
+    ExpressionTail & tail = exp.m_tail.edit();
+
+    if((exp.form() == CallForm) && exp.m_head.isSymbol() && (tail.site == ExpressionTail::NO_SITE)){
+      tail.site = acquire_call_site();
+    }
+
+    // the parameter list itself is not a reference, only the body is
+    if((exp.form() == LambdaForm) && (tail.size() == 2) && tail[0].isHeadSymbol()){
+      Scope params;
+      params.push_back(tail[0].m_head.symbolId());
+      for(const auto & p : tail[0].m_tail){
+        params.push_back(p.m_head.isSymbol() ? p.m_head.symbolId() : NOT_A_PARAM);
+      }
+      if(params.size() < NO_SLOT){
+        scopes.push_back(std::move(params));
+        pending.emplace_back(&tail[1], static_cast<int>(scopes.size() - 1));
+      }
+      else{
+        pending.emplace_back(&tail[1], -1);
+      }
+      continue;
+    }
+
+    for(auto & e : tail){
+      pending.emplace_back(&e, scope);
+    }
+  }
+}
+
+int Expression::paramSlot() const noexcept{
+  return (m_slot != NO_SLOT) ? m_slot : -1;
+}
+
+long Expression::callSite() const noexcept{
+  const ExpressionTail * tail = m_tail.stored();
+  return ((tail != nullptr) && (tail->site != ExpressionTail::NO_SITE)) ? static_cast<long>(tail->site) : -1;
+}
+
+const ExpressionTail * Expression::sharedTail() const noexcept{
+  return m_tail.stored();
+}
+
 Expression::ConstIteratorType Expression::tailConstBegin() const noexcept{
   return m_tail.cbegin();
 }
@@ -125,47 +463,67 @@ Expression::ConstIteratorType Expression::tailConstEnd() const noexcept{
   return m_tail.cend();
 }
 
-void handleApplyLambda(const std::vector<Expression> & arg, const std::vector<Expression> & input, Environment & env)
+// bind args to the parameters of lambda in frame and return its body, which
+// lives in the tail of lambda
+static const Expression & bind_lambda(const Expression & lambda, const std::vector<Expression> & args, Environment & frame)
 {
-  //check if variables have already been defined
-  for (auto it = input.begin(), it2 = arg.begin(); it != input.end(), it2 != arg.end(); ++it, ++it2)
-  {
-    env.add_replace((*it).head(), (*it2));//ceheck to see if in env
-  }
-}
+  static const Expression none;
 
-Expression apply(const Atom & op, const std::vector<Expression> & args, const Environment & env){
+  const Expression * procedure = &none;
+  std::size_t count = 0;
 
-  if (env.is_exp(op))
+  for (auto it = lambda.tailConstBegin(); it != lambda.tailConstEnd(); ++it)
   {
-    Environment env2(env);
-    Expression expLambda = env2.get_exp(op);
-    Expression procedure;
-    std::vector<Expression> arguments;
-
-    for (auto it = expLambda.tailConstBegin(); it != expLambda.tailConstEnd(); ++it)
+    if ((*it).isHeadList())
     {
-      if ((*it).isHeadList())
+      count += (*it).tailSize();
+      if (args.size() != count)
       {
-        for (auto it2 = (*it).tailConstBegin(); it2 != (*it).tailConstEnd(); ++it2)
-        {
-          arguments.push_back(*it2);
-        }
-        if (args.size() != arguments.size())
-        {
-          throw SemanticError("Error during evaluation: arguments do not match up with args");
-        }
+        throw SemanticError("Error during evaluation: arguments do not match up with args");
       }
-      else
+    }
+    else
+    {
+      procedure = &(*it);//get the procedure and evaluate after putting expression in environment
+    }
+  }
+
+  // bind each parameter, in order, to the matching argument
+  auto arg = args.begin();
+  for (auto it = lambda.tailConstBegin(); it != lambda.tailConstEnd(); ++it)
+  {
+    if ((*it).isHeadList())
+    {
+      std::size_t index = 0;
+      for (auto param = (*it).tailConstBegin(); param != (*it).tailConstEnd(); ++param, ++arg, ++index)
       {
-        procedure = (*it);//get the procedure and evaluate after putting expression in environment
+        frame.bind_param(index, (*param).head(), *arg);
       }
     }
-    handleApplyLambda(args, arguments, env2);
+  }
 
-    return procedure.eval(env2);
+  return *procedure;
+}
+
+static Expression apply_procedure(const Atom & op, ArgSpan args, const Environment & env);
+
+Expression apply(const Atom & op, const std::vector<Expression> & args, const Environment & env){
+
+  if (env.is_exp(op))
+  {
+    // parameters are bound in a frame chained to the calling environment
+    Environment env2(&env);
+    Expression expLambda = env.get_exp(op);
+
+    return bind_lambda(expLambda, args, env2).eval(env2);
   }
 
+  return apply_procedure(op, args, env);
+}
+
+// apply the built-in procedure named by op, which is not bound to an expression
+static Expression apply_procedure(const Atom & op, ArgSpan args, const Environment & env){
+
     // head must be a symbol
     if(!op.isSymbol()){
       throw SemanticError("Error during evaluation: procedure name not symbol");
@@ -183,10 +541,18 @@ Expression apply(const Atom & op, const std::vector<Expression> & args, const En
   return proc(args);
 }
 
-Expression Expression::handle_lookup(const Atom & head, const Environment & env){
+Expression Expression::handle_lookup(const Atom & head, const Environment & env) const{
     if(head.isSymbol()){ // if symbol is in env return value
-      if(env.is_exp(head) || env.is_proc(head)){
-	       return env.get_exp(head);
+      // a parameter of the lambda being evaluated is read by position
+      if(m_slot != NO_SLOT){
+        const Expression * param = env.get_param(m_slot, head.symbolId());
+        if(param != nullptr){
+          return *param;
+        }
+      }
+      const Expression * value = env.lookup(head);
+      if(value != nullptr){
+	       return *value;
       }
       else if (head.asSymbol()[0] == 34 && head.asSymbol()[head.asSymbol().length()-1] == 34)
       {
@@ -204,13 +570,13 @@ Expression Expression::handle_lookup(const Atom & head, const Environment & env)
     }
 }
 
-Expression Expression::handle_apply(Environment & env)
+Expression Expression::handle_apply(Environment & env) const
 {
   if (m_tail.size() != 2)
   {
     throw SemanticError("Error: not enough arguments in apply");//error checking
   }
-  if (m_tail[1].head().asSymbol() != "list")
+  if (m_tail[1].form() != ListForm)
   {
     throw SemanticError("Error: second argument to apply not a list");
   }
@@ -239,7 +605,7 @@ Expression Expression::handle_apply(Environment & env)
   return newExp.eval(env);
 }
 
-Expression Expression::handle_lambda(Environment & env)
+Expression Expression::handle_lambda(Environment & env) const
 {
     if(m_tail.size() != 2){
       throw SemanticError("Error during evaluation: not enough or too much arguments to lambda");
@@ -260,58 +626,119 @@ Expression Expression::handle_lambda(Environment & env)
       temp.m_tail.push_back(*it);
     }
 
-    expressions.push_back(Expression(temp));
-    expressions.push_back(Expression(m_tail[1]));
+    expressions.push_back(std::move(temp));
+    expressions.push_back(m_tail[1]);
 
-    return Expression(expressions);
+    return Expression(std::move(expressions));
 }
 
-Expression Expression::handle_map(Environment & env)
+Expression Expression::handle_map(Environment & env) const
 {//very similar to apply, difference is that you iterate through the args to map to lambda
   if (m_tail.size() != 2)
   {
     throw SemanticError("Error: not enough arguments in map");
   }
 
-  Expression resultList = m_tail[1].eval(env);
+  // a map over a map runs each procedure over the whole list in turn, the
+  // innermost first, as the separate maps would, so the calls and their
+  // errors come in the same order. The results of each procedure replace
+  // those of the one before in place, so the lists in between are never
+  // built.
+  std::vector<const Expression *> procs;
+  const Expression * source = this;
+  do
+  {
+    procs.push_back(&source->m_tail[0]);
+    source = &source->m_tail[1];
+  } while (source->form() == MapForm && source->m_tail.size() == 2);
 
-  if (m_tail[1].head().asSymbol() != "list" && !resultList.isHeadList())
+  auto check = [&env](const Expression & proc)
   {
-    throw SemanticError("Error: second argument to map not a list");
-  }
-  Expression removeSymbols = m_tail[1].eval(env);
-  if (env.is_exp(m_tail[0].head()))
+    if (!env.is_exp(proc.head()) && (proc.tailSize() != 0 || !env.is_proc(proc.head())))
+    {
+      throw SemanticError("Error: first argument to map not a procedure");
+    }
+  };
+
+  std::vector<Expression> tempExpression(1);
+  std::vector<Expression> finalResult;
+  const Expression & innermost = *procs.back();
+  auto stream = [&](Expression && element)
   {
-    std::vector<Expression> tempExpression;
-    std::vector<Expression> finalResult;
-    for (auto it = removeSymbols.tailConstBegin(); it != removeSymbols.tailConstEnd(); ++it)
+    tempExpression[0] = std::move(element);
+    finalResult.push_back(apply(innermost.head(), tempExpression, env));
+  };
+
+  // the outer procedures, after the innermost has been applied to every
+  // element
+  auto remaining = [&]()
+  {
+    for (auto p = procs.rbegin() + 1; p != procs.rend(); ++p)
     {
-      tempExpression.push_back(*it);
-      Expression returned = apply(m_tail[0].head(),tempExpression, env);
-      finalResult.push_back(returned);
-      tempExpression.clear();
+      check(**p);
+      for (auto & element : finalResult)
+      {
+        tempExpression[0] = std::move(element);
+        element = apply((*p)->head(), tempExpression, env);
+      }
+    }
+    return Expression(std::move(finalResult));
+  };
+
+  // a call to a procedure building a sequence, such as range, is streamed
+  // without building the sequence
+  if (source->form() == CallForm && source->head().isSymbol() &&
+      !env.is_exp(source->head()) && env.is_proc(source->head()))
+  {
+    Procedure proc = env.get_proc(source->head());
+    if (proc.is_sequence())
+    {
+      std::vector<Expression> args;
+      args.reserve(source->tailSize());
+      for (auto it = source->tailConstBegin(); it != source->tailConstEnd(); ++it)
+      {
+        args.push_back(it->eval(env));
+      }
+      Procedure::Sequence sequence = proc.describe(args);
+      check(innermost);
+
+      finalResult.reserve(sequence.size_hint());
+      for (double x = sequence.begin; x <= sequence.end; x += sequence.step)
+      {
+        stream(Expression(Atom(x)));
+      }
+      return remaining();
     }
-    return Expression(finalResult);
   }
 
-  if (m_tail[0].tailSize() != 0 || !env.is_proc(m_tail[0].head()))
+  Expression list = source->eval(env);
+  if (source->form() != ListForm && !list.isHeadList())
   {
-    throw SemanticError("Error: first argument to map not a procedure");
+    throw SemanticError("Error: second argument to map not a list");
   }
+  check(innermost);
 
-  std::vector<Expression> tempExpression;
-  std::vector<Expression> finalResult;
-  for (auto it = removeSymbols.tailConstBegin(); it != removeSymbols.tailConstEnd(); ++it)
+  finalResult.reserve(list.tailSize());
+
+  // the numbers of a packed list are passed without building its elements
+  if (list.isPackedList())
+  {
+    for (double d : list.packedNumbers())
+    {
+      stream(Expression(Atom(d)));
+    }
+  }
+  else
   {
-    tempExpression.push_back(*it);
-    Expression returned = apply(m_tail[0].head(),tempExpression, env);
-    finalResult.push_back(returned);
-    tempExpression.clear();
+    for (auto it = list.tailConstBegin(); it != list.tailConstEnd(); ++it)
+    {
+      stream(Expression(*it));
+    }
   }
-  return Expression(finalResult);
+  return remaining();
 }
 
-Expression Expression::handle_begin(Environment & env){
+Expression Expression::handle_begin(Environment & env) const{
 
   if(m_tail.size() == 0){
     throw SemanticError("Error during evaluation: zero arguments to begin");
@@ -323,14 +750,14 @@ Expression Expression::handle_begin(Environment & env){
 
   // evaluate each arg from tail, return the last
   Expression result;
-  for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
+  for(Expression::ConstIteratorType it = m_tail.cbegin(); it != m_tail.cend(); ++it){
     result = it->eval(env);
   }
 
   return result;
 }
 
-Expression Expression::handle_setProp(Environment & env){
+Expression Expression::handle_setProp(Environment & env) const{
 
   if(m_tail.size() != 3)
   {
@@ -345,12 +772,12 @@ Expression Expression::handle_setProp(Environment & env){
   Expression third = m_tail[2].eval(env);
   m_tail[1].eval(env);
 
-  third.prop[m_tail[0].head().asSymbol()] = m_tail[1].eval(env);
+  third.setProperty(m_tail[0].head().symbolId(), m_tail[1].eval(env));
 
   return third;
 }
 
-Expression Expression::handle_getProp(Environment & env)
+Expression Expression::handle_getProp(Environment & env) const
 {
   if (m_tail.size() != 2)
   {
@@ -362,11 +789,11 @@ Expression Expression::handle_getProp(Environment & env)
     throw SemanticError("Error: first argument to get-property not a string");
   }
 
-  return (m_tail[1].eval(env).prop[m_tail[0].head().asSymbol()]);
+  return m_tail[1].eval(env).getProperty(m_tail[0].head().symbolId());
 }
 
 
-Expression Expression::handle_define(Environment & env){
+Expression Expression::handle_define(Environment & env) const{
 
   // tail must have size 3 or error
   if(m_tail.size() != 2){
@@ -379,8 +806,8 @@ Expression Expression::handle_define(Environment & env){
   }
 
   // but tail[0] must not be a special-form or procedure
-  std::string s = m_tail[0].head().asSymbol();//stores the first argument after define
-  if((s == "define") || (s == "begin") || (s == "apply")){
+  Form f = m_tail[0].form();//the form named by the first argument after define
+  if((f == DefineForm) || (f == BeginForm) || (f == ApplyForm)){
     throw SemanticError("Error during evaluation: attempt to redefine a special-form");
   }
 
@@ -394,7 +821,7 @@ Expression Expression::handle_define(Environment & env){
 }
 
 
-void Expression::generateBoundingBoxLines(Expression & plotResult, double & scaledAU, double & scaledAL, double & scaledOU, double & scaledOL)
+void Expression::generateBoundingBoxLines(Expression & plotResult, double & scaledAU, double & scaledAL, double & scaledOU, double & scaledOL) const
 {
   std::vector<Expression> resultLines;
 
@@ -448,37 +875,37 @@ void Expression::generateBoundingBoxLines(Expression & plotResult, double & scal
   Expression linePoints;
   linePoints.m_tail.push_back(pointTopLeft);
   linePoints.m_tail.push_back(pointTopRight);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   linePoints.head().setList();
   plotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
   linePoints.m_tail.push_back(pointTopRight);
   linePoints.m_tail.push_back(pointBottomRight);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   plotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
   linePoints.m_tail.push_back(pointBottomRight);
   linePoints.m_tail.push_back(pointBottomLeft);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   plotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
   linePoints.m_tail.push_back(pointBottomLeft);
   linePoints.m_tail.push_back(pointTopLeft);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   plotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
   linePoints.m_tail.push_back(pointMiddleTop);
   linePoints.m_tail.push_back(pointBottomMiddle);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   plotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
@@ -486,62 +913,62 @@ void Expression::generateBoundingBoxLines(Expression & plotResult, double & scal
   {
     linePoints.m_tail.push_back(pointLeftMiddle);
     linePoints.m_tail.push_back(pointRightMiddle);
-    linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-    linePoints.prop["\"thickness\""] = Expression(0);
+    linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+    linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
     plotResult.m_tail.push_back(linePoints);
     linePoints.m_tail.clear();
   }
 
 }
 
-void Expression::createStrings(double & au, double & al, double & ol, double & ou, double & scaledAU, double & scaledAL, double & scaledOL, double & scaledOU, Expression & plotResult)
+void Expression::createStrings(double & au, double & al, double & ol, double & ou, double & scaledAU, double & scaledAL, double & scaledOL, double & scaledOU, Expression & plotResult) const
 {
   Expression au1 = Expression("\"" + std::to_string(int(au)) + "\"");
-  au1.prop["\"object-name\""] = Expression(Atom("\"text\""));
+  au1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
   Expression x;
   x.append(Atom(scaledAU));
   x.append(Atom(-(scaledOL-2)));
   x.head().setList();
-  au1.prop["\"position\""] = x;
-  au1.prop["\"scale\""] = Expression(1);
-  au1.prop["\"rotation\""] = Expression(0);
+  au1.setProperty(POSITION_PROPERTY, x);
+  au1.setProperty(SCALE_PROPERTY, Expression(1));
+  au1.setProperty(ROTATION_PROPERTY, Expression(0));
   plotResult.m_tail.push_back(au1);
 
   Expression al1 = Expression("\"" + std::to_string(int(al)) + "\"");
-  al1.prop["\"object-name\""] = Expression(Atom("\"text\""));
+  al1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
   Expression y;
   y.append(Atom(scaledAL));
   y.append(Atom(-(scaledOL-2)));
   y.head().setList();
-  al1.prop["\"position\""] = y;
-  al1.prop["\"scale\""] = Expression(1);
-  al1.prop["\"rotation\""] = Expression(0);
+  al1.setProperty(POSITION_PROPERTY, y);
+  al1.setProperty(SCALE_PROPERTY, Expression(1));
+  al1.setProperty(ROTATION_PROPERTY, Expression(0));
   plotResult.m_tail.push_back(al1);
 
   Expression ol1 = Expression("\"" + std::to_string(int(ol)) + "\"");
-  ol1.prop["\"object-name\""] = Expression(Atom("\"text\""));
+  ol1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
   Expression a;
   a.append(Atom(scaledAL-2));
   a.append(Atom(-scaledOL));
   a.head().setList();
-  ol1.prop["\"position\""] = a;
-  ol1.prop["\"scale\""] = Expression(1);
-  ol1.prop["\"rotation\""] = Expression(0);
+  ol1.setProperty(POSITION_PROPERTY, a);
+  ol1.setProperty(SCALE_PROPERTY, Expression(1));
+  ol1.setProperty(ROTATION_PROPERTY, Expression(0));
   plotResult.m_tail.push_back(ol1);
 
   Expression ou1 = Expression("\"" + std::to_string(int(ou)) + "\"");
-  ou1.prop["\"object-name\""] = Expression(Atom("\"text\""));
+  ou1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
   Expression z;
   z.append(Atom(scaledAL-2));
   z.append(Atom(-scaledOU));
   z.head().setList();
-  ou1.prop["\"position\""] = z;
-  ou1.prop["\"scale\""] = Expression(1);
-  ou1.prop["\"rotation\""] = Expression(0);
+  ou1.setProperty(POSITION_PROPERTY, z);
+  ou1.setProperty(SCALE_PROPERTY, Expression(1));
+  ou1.setProperty(ROTATION_PROPERTY, Expression(0));
   plotResult.m_tail.push_back(ou1);
 }
 
-void Expression::scalePointsLines(Expression & plotResult, Expression & evalText, Expression & evalPoints, double & au, double & al, double & ol, double & ou)
+void Expression::scalePointsLines(Expression & plotResult, Expression & evalText, Expression & evalPoints, double & au, double & al, double & ol, double & ou) const
 {
   //points contains the flipped points
   //lines contains the lines from flipped points to the complimentary
@@ -565,8 +992,8 @@ void Expression::scalePointsLines(Expression & plotResult, Expression & evalText
 
     flippedPoint.append((*it).m_tail[0].head().asNumber() * xscale);
     flippedPoint.append((*it).m_tail[1].head().asNumber() * -1 * yscale);
-    flippedPoint.prop["\"object-name\""] = Expression(Atom("\"point\""));
-    flippedPoint.prop["\"size\""] = Expression(0.5);
+    flippedPoint.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"point\"")));
+    flippedPoint.setProperty(SIZE_PROPERTY, Expression(0.5));
     flippedPoint.head().setList();
 
     plotResult.m_tail.push_back(flippedPoint);
@@ -593,8 +1020,8 @@ void Expression::scalePointsLines(Expression & plotResult, Expression & evalText
 
     line = Expression(linePoints);
 
-    line.prop["\"object-name\""] = Expression(Atom("\"line\""));
-    line.prop["\"thickness\""] = Expression(0);
+    line.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+    line.setProperty(THICKNESS_PROPERTY, Expression(0));
     plotResult.m_tail.push_back(line);
 
     linePoints.clear();
@@ -605,7 +1032,7 @@ void Expression::scalePointsLines(Expression & plotResult, Expression & evalText
   generateTextLabels(plotResult, evalText, scaledAU, scaledAL, scaledOL, scaledOU);
 }
 
-Expression Expression::handle_discretePlot(Environment &env)
+Expression Expression::handle_discretePlot(Environment &env) const
 {
   Expression plotResult;//big list
 
@@ -654,7 +1081,7 @@ Expression Expression::handle_discretePlot(Environment &env)
   return plotResult;
 }
 
-void Expression::generateTextLabels(Expression & plotResult, Expression & evalText, double & scaledAU, double & scaledAL, double & scaledOL, double & scaledOU)
+void Expression::generateTextLabels(Expression & plotResult, Expression & evalText, double & scaledAU, double & scaledAL, double & scaledOL, double & scaledOU) const
 {
   Expression scale = Expression(1);
 
@@ -666,42 +1093,42 @@ void Expression::generateTextLabels(Expression & plotResult, Expression & evalTe
     if ((*it).m_tail[0].head().asSymbol() == "\"title\"")
     {
       Expression title = (*it).m_tail[1];
-      title.prop["\"object-name\""] = Expression(Atom("\"text\""));
+      title.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
       Expression x;
       x.append(Atom(xmiddle));
       x.append(Atom(-(scaledOU+3)));
       x.head().setList();
-      title.prop["\"position\""] = x;
-      title.prop["\"scale\""] = scale;
-      title.prop["\"rotation\""] = Expression(0);
+      title.setProperty(POSITION_PROPERTY, x);
+      title.setProperty(SCALE_PROPERTY, scale);
+      title.setProperty(ROTATION_PROPERTY, Expression(0));
       plotResult.m_tail.push_back(title);
       x.m_tail.clear();
     }
     else if ((*it).m_tail[0].head().asSymbol() == "\"abscissa-label\"")
     {
       Expression absLabel = (*it).m_tail[1];
-      absLabel.prop["\"object-name\""] = Expression(Atom("\"text\""));
+      absLabel.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
       Expression x;
       x.append(Atom(xmiddle));
       x.append(Atom(-(scaledOL-3)));
       x.head().setList();
-      absLabel.prop["\"position\""] = x;
-      absLabel.prop["\"scale\""] = scale;
-      absLabel.prop["\"rotation\""] = Expression(0);
+      absLabel.setProperty(POSITION_PROPERTY, x);
+      absLabel.setProperty(SCALE_PROPERTY, scale);
+      absLabel.setProperty(ROTATION_PROPERTY, Expression(0));
       plotResult.m_tail.push_back(absLabel);
       x.m_tail.clear();
     }
     else if ((*it).m_tail[0].head().asSymbol() == "\"ordinate-label\"")
     {
       Expression ordLabel = (*it).m_tail[1];
-      ordLabel.prop["\"object-name\""] = Expression(Atom("\"text\""));
+      ordLabel.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
       Expression x;
       x.append(Atom(scaledAL-3));
       x.append(Atom(-ymiddle));
       x.head().setList();
-      ordLabel.prop["\"position\""] = x;
-      ordLabel.prop["\"scale\""] = scale;
-      ordLabel.prop["\"rotation\""] = Expression(-90);
+      ordLabel.setProperty(POSITION_PROPERTY, x);
+      ordLabel.setProperty(SCALE_PROPERTY, scale);
+      ordLabel.setProperty(ROTATION_PROPERTY, Expression(-90));
       plotResult.m_tail.push_back(ordLabel);
       x.m_tail.clear();
     }
@@ -712,7 +1139,7 @@ void Expression::generateTextLabels(Expression & plotResult, Expression & evalTe
   }
 }
 
-Expression Expression::handle_continuousPlot(Environment &env)
+Expression Expression::handle_continuousPlot(Environment &env) const
 {
   Expression conPlotResult;//big list
 
@@ -764,8 +1191,8 @@ Expression Expression::handle_continuousPlot(Environment &env)
     }
     point.append(Atom(rawYCord));
 
-    point.prop["\"object-name\""] = Expression(Atom("\"point\""));
-    point.prop["\"size\""] = Expression(0.5);//give the properties
+    point.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"point\"")));
+    point.setProperty(SIZE_PROPERTY, Expression(0.5));//give the properties
     point.head().setList();
     points.push_back(point);
 
@@ -803,7 +1230,7 @@ Expression Expression::handle_continuousPlot(Environment &env)
   return conPlotResult;
 }
 
-void Expression::continuousAngleCalc(Expression & conPlotResult, std::vector<Expression> points, double & xscale, double & yscale, Environment & env)
+void Expression::continuousAngleCalc(Expression & conPlotResult, std::vector<Expression> points, double & xscale, double & yscale, Environment & env) const
 {
   int counter = 0;
   bool changed = false;
@@ -850,8 +1277,8 @@ void Expression::continuousAngleCalc(Expression & conPlotResult, std::vector<Exp
     line.m_tail.push_back(*it2);
 
     line.head().setList();
-    line.prop["\"object-name\""] = Expression(Atom("\"line\""));
-    line.prop["\"thickness\""] = Expression(0);
+    line.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+    line.setProperty(THICKNESS_PROPERTY, Expression(0));
     conPlotResult.m_tail.push_back(line);
 
     line.m_tail.clear();
@@ -859,15 +1286,15 @@ void Expression::continuousAngleCalc(Expression & conPlotResult, std::vector<Exp
 }
 
 
-std::vector<Expression> Expression::splitLine(Expression point1, Expression point2, Expression point3, double & xscale, double & yscale, Environment & env)
+std::vector<Expression> Expression::splitLine(Expression point1, Expression point2, Expression point3, double & xscale, double & yscale, Environment & env) const
 {
   double midx21 = (point1.m_tail[0].head().asNumber() + point2.m_tail[0].head().asNumber()) / 2;//midpoint x line 1
   double midx31 = (point3.m_tail[0].head().asNumber() + point2.m_tail[0].head().asNumber()) / 2;//midpoint x line 2
 
   Expression midpoint1;
   Expression midpoint2;//two points
-  midpoint1.prop["\"object-name\""] = Expression(Atom("\"point\""));
-  midpoint2.prop["\"size\""] = Expression(0.5);
+  midpoint1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"point\"")));
+  midpoint2.setProperty(SIZE_PROPERTY, Expression(0.5));
   midpoint1.head().setList();
   midpoint2.head().setList();
   std::vector<Expression> mid1;
@@ -899,7 +1326,7 @@ std::vector<Expression> Expression::splitLine(Expression point1, Expression poin
 
 }
 
-bool Expression::checkAngle175(Expression point1, Expression point2, Expression point3)
+bool Expression::checkAngle175(Expression point1, Expression point2, Expression point3) const
 {
   double dx21 = point2.m_tail[0].head().asNumber() - point1.m_tail[0].head().asNumber();//vector i1
   double dy21 = point2.m_tail[1].head().asNumber() - point1.m_tail[1].head().asNumber();//vector j1
@@ -928,54 +1355,54 @@ bool Expression::checkAngle175(Expression point1, Expression point2, Expression
   }
 }
 
-void Expression::continuousCreateStrings(Expression & conPlotResult, double & au2, double & al2, double & ol2, double & ou2, double & scaledAU2, double & scaledAL2, double & scaledOL2, double & scaledOU2)
+void Expression::continuousCreateStrings(Expression & conPlotResult, double & au2, double & al2, double & ol2, double & ou2, double & scaledAU2, double & scaledAL2, double & scaledOL2, double & scaledOU2) const
 {
   Expression au1 = Expression(round(au2));
-  au1.prop["\"object-name\""] = Expression(Atom("\"text\""));
+  au1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
   Expression x;
   x.append(Atom(scaledAU2));
   x.append(Atom(-(scaledOL2-2)));
   x.head().setList();
-  au1.prop["\"position\""] = x;
-  au1.prop["\"scale\""] = Expression(1);
-  au1.prop["\"rotation\""] = Expression(0);
+  au1.setProperty(POSITION_PROPERTY, x);
+  au1.setProperty(SCALE_PROPERTY, Expression(1));
+  au1.setProperty(ROTATION_PROPERTY, Expression(0));
   conPlotResult.m_tail.push_back(au1);
 
   Expression al1 = Expression(round(al2));
-  al1.prop["\"object-name\""] = Expression(Atom("\"text\""));
+  al1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
   Expression y;
   y.append(Atom(scaledAL2));
   y.append(Atom(-(scaledOL2-2)));
   y.head().setList();
-  al1.prop["\"position\""] = y;
-  al1.prop["\"scale\""] = Expression(1);
-  al1.prop["\"rotation\""] = Expression(0);
+  al1.setProperty(POSITION_PROPERTY, y);
+  al1.setProperty(SCALE_PROPERTY, Expression(1));
+  al1.setProperty(ROTATION_PROPERTY, Expression(0));
   conPlotResult.m_tail.push_back(al1);
 
   Expression ol1 = Expression(round(ol2));
-  ol1.prop["\"object-name\""] = Expression(Atom("\"text\""));
+  ol1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
   Expression a;
   a.append(Atom(scaledAL2-2));
   a.append(Atom(-scaledOL2));
   a.head().setList();
-  ol1.prop["\"position\""] = a;
-  ol1.prop["\"scale\""] = Expression(1);
-  ol1.prop["\"rotation\""] = Expression(0);
+  ol1.setProperty(POSITION_PROPERTY, a);
+  ol1.setProperty(SCALE_PROPERTY, Expression(1));
+  ol1.setProperty(ROTATION_PROPERTY, Expression(0));
   conPlotResult.m_tail.push_back(ol1);
 
   Expression ou1 = Expression(round(ou2));
-  ou1.prop["\"object-name\""] = Expression(Atom("\"text\""));
+  ou1.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
   Expression z;
   z.append(Atom(scaledAL2-2));
   z.append(Atom(-scaledOU2));
   z.head().setList();
-  ou1.prop["\"position\""] = z;
-  ou1.prop["\"scale\""] = Expression(1);
-  ou1.prop["\"rotation\""] = Expression(0);
+  ou1.setProperty(POSITION_PROPERTY, z);
+  ou1.setProperty(SCALE_PROPERTY, Expression(1));
+  ou1.setProperty(ROTATION_PROPERTY, Expression(0));
   conPlotResult.m_tail.push_back(ou1);
 }
 
-void Expression::continuousTextLabels(Expression & conPlotResult, Expression & evalText, double & scaledOL2, double & scaledOU2, double & scaledAL2, double & scaledAU2)
+void Expression::continuousTextLabels(Expression & conPlotResult, Expression & evalText, double & scaledOL2, double & scaledOU2, double & scaledAL2, double & scaledAU2) const
 {
   Expression scale = Expression(1);
 
@@ -987,42 +1414,42 @@ void Expression::continuousTextLabels(Expression & conPlotResult, Expression & e
     if ((*it).m_tail[0].head().asSymbol() == "\"title\"")
     {
       Expression title = (*it).m_tail[1];
-      title.prop["\"object-name\""] = Expression(Atom("\"text\""));
+      title.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
       Expression x;
       x.append(Atom(xmiddle));
       x.append(Atom(-(scaledOU2+3)));
       x.head().setList();
-      title.prop["\"position\""] = x;
-      title.prop["\"scale\""] = scale;
-      title.prop["\"rotation\""] = Expression(0);
+      title.setProperty(POSITION_PROPERTY, x);
+      title.setProperty(SCALE_PROPERTY, scale);
+      title.setProperty(ROTATION_PROPERTY, Expression(0));
       conPlotResult.m_tail.push_back(title);
       x.m_tail.clear();
     }
     else if ((*it).m_tail[0].head().asSymbol() == "\"abscissa-label\"")
     {
       Expression absLabel = (*it).m_tail[1];
-      absLabel.prop["\"object-name\""] = Expression(Atom("\"text\""));
+      absLabel.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
       Expression x;
       x.append(Atom(xmiddle));
       x.append(Atom(-(scaledOL2-3)));
       x.head().setList();
-      absLabel.prop["\"position\""] = x;
-      absLabel.prop["\"scale\""] = scale;
-      absLabel.prop["\"rotation\""] = Expression(0);
+      absLabel.setProperty(POSITION_PROPERTY, x);
+      absLabel.setProperty(SCALE_PROPERTY, scale);
+      absLabel.setProperty(ROTATION_PROPERTY, Expression(0));
       conPlotResult.m_tail.push_back(absLabel);
       x.m_tail.clear();
     }
     else if ((*it).m_tail[0].head().asSymbol() == "\"ordinate-label\"")
     {
       Expression ordLabel = (*it).m_tail[1];
-      ordLabel.prop["\"object-name\""] = Expression(Atom("\"text\""));
+      ordLabel.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"text\"")));
       Expression x;
       x.append(Atom(scaledAL2-3));
       x.append(Atom(-ymiddle));
       x.head().setList();
-      ordLabel.prop["\"position\""] = x;
-      ordLabel.prop["\"scale\""] = scale;
-      ordLabel.prop["\"rotation\""] = Expression(-90);
+      ordLabel.setProperty(POSITION_PROPERTY, x);
+      ordLabel.setProperty(SCALE_PROPERTY, scale);
+      ordLabel.setProperty(ROTATION_PROPERTY, Expression(-90));
       conPlotResult.m_tail.push_back(ordLabel);
       x.m_tail.clear();
     }
@@ -1033,7 +1460,7 @@ void Expression::continuousTextLabels(Expression & conPlotResult, Expression & e
   }
 }
 
-std::string Expression::round(double num)
+std::string Expression::round(double num) const
 {
     std::ostringstream os;
     os << std::setprecision(2);
@@ -1045,7 +1472,7 @@ std::string Expression::round(double num)
 }
 
 
-void Expression::continuousBoundingBox(Expression & conPlotResult, double & scaledOL2, double & scaledOU2, double & scaledAL2, double & scaledAU2)
+void Expression::continuousBoundingBox(Expression & conPlotResult, double & scaledOL2, double & scaledOU2, double & scaledAL2, double & scaledAU2) const
 {
   Expression pointBottomLeft;
   pointBottomLeft.append(Atom(scaledAL2));
@@ -1095,37 +1522,37 @@ void Expression::continuousBoundingBox(Expression & conPlotResult, double & scal
   Expression linePoints;
   linePoints.m_tail.push_back(pointTopLeft);
   linePoints.m_tail.push_back(pointTopRight);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   linePoints.head().setList();
   conPlotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
   linePoints.m_tail.push_back(pointTopRight);
   linePoints.m_tail.push_back(pointBottomRight);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   conPlotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
   linePoints.m_tail.push_back(pointBottomRight);
   linePoints.m_tail.push_back(pointBottomLeft);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   conPlotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
   linePoints.m_tail.push_back(pointBottomLeft);
   linePoints.m_tail.push_back(pointTopLeft);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   conPlotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
   linePoints.m_tail.push_back(pointMiddleTop);
   linePoints.m_tail.push_back(pointBottomMiddle);
-  linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-  linePoints.prop["\"thickness\""] = Expression(0);
+  linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+  linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
   conPlotResult.m_tail.push_back(linePoints);
   linePoints.m_tail.clear();
 
@@ -1133,41 +1560,41 @@ void Expression::continuousBoundingBox(Expression & conPlotResult, double & scal
   {
     linePoints.m_tail.push_back(pointLeftMiddle);
     linePoints.m_tail.push_back(pointRightMiddle);
-    linePoints.prop["\"object-name\""] = Expression(Atom("\"line\""));
-    linePoints.prop["\"thickness\""] = Expression(0);
+    linePoints.setProperty(OBJECT_NAME_PROPERTY, Expression(Atom("\"line\"")));
+    linePoints.setProperty(THICKNESS_PROPERTY, Expression(0));
     conPlotResult.m_tail.push_back(linePoints);
     linePoints.m_tail.clear();
   }
 }
 
-Expression Expression::handleMakePoint() const noexcept
+const Expression & Expression::handleMakePoint() const noexcept
 {
-  return prop.at("\"size\"");
+  return getProperty(SIZE_PROPERTY);
 }
 
-Expression Expression::handleMakeLine() const noexcept
+const Expression & Expression::handleMakeLine() const noexcept
 {
-  return prop.at("\"thickness\"");
+  return getProperty(THICKNESS_PROPERTY);
 }
 
-Expression Expression::handleMakeText() const noexcept
+const Expression & Expression::handleMakeText() const noexcept
 {
-  return prop.at("\"position\"");
+  return getProperty(POSITION_PROPERTY);
 }
 
-Expression Expression::handleRotation() const noexcept
+const Expression & Expression::handleRotation() const noexcept
 {
-  return prop.at("\"rotation\"");
+  return getProperty(ROTATION_PROPERTY);
 }
 
-Expression Expression::handleScale() const noexcept
+const Expression & Expression::handleScale() const noexcept
 {
-  return prop.at("\"scale\"");
+  return getProperty(SCALE_PROPERTY);
 }
 
-Expression Expression::searchMap() const noexcept
+const Expression & Expression::searchMap() const noexcept
 {
-  return prop.at("\"object-name\"");
+  return getProperty(OBJECT_NAME_PROPERTY);
 }
 
 
@@ -1176,68 +1603,335 @@ int Expression::getPropSize() const noexcept
   return prop.size();
 }
 
-// this is a simple recursive version. the iterative version is more
-// difficult with the ast data structure used (no parent pointer).
-// this limits the practical depth of our AST
-Expression Expression::eval(Environment & env){
+// order properties by key
+static bool property_less(const std::pair<SymbolTable::IdType, Expression> & p, SymbolTable::IdType key)
+{
+  return p.first < key;
+}
 
-  if (global_status_flag > 0)
+void Expression::setProperty(SymbolTable::IdType key, const Expression & value)
+{
+  std::vector<std::pair<SymbolTable::IdType, Expression>> & props = prop.edit();
+
+  // plot primitives carry up to four properties
+  if (props.empty())
   {
-    throw SemanticError("Error: interpreter kernel interrupted");
-    //return Expression(Atom("Error: interpreter kernel interrupted"));
+    props.reserve(4);
   }
 
-  if(m_tail.empty()){
-    if (m_head.isSymbol() && m_head.asSymbol() == "list")//check case for empty list
-    {
-      return Expression(m_tail);
-    }
-    return handle_lookup(m_head, env);
-  }
-  // handle begin special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "begin"){
-    return handle_begin(env);
-  }
-  // handle define special-form
-  else if(m_head.isSymbol() && m_head.asSymbol() == "define"){
-    return handle_define(env);
-  }
-  else if (m_head.isSymbol() && m_head.asSymbol() == "lambda")
+  auto it = std::lower_bound(props.begin(), props.end(), key, property_less);
+  if (it != props.end() && it->first == key)
   {
-    return handle_lambda(env);
+    it->second = value;
   }
-  else if (m_head.isSymbol() && m_head.asSymbol() == "apply")
+  else
   {
-    return handle_apply(env);
+    props.emplace(it, key, value);
   }
-  else if (m_head.isSymbol() && m_head.asSymbol() == "map")
+}
+
+const Expression & Expression::getProperty(SymbolTable::IdType key) const noexcept
+{
+  const std::vector<std::pair<SymbolTable::IdType, Expression>> & props = prop.get();
+
+  static const Expression none;
+
+  auto it = std::lower_bound(props.begin(), props.end(), key, property_less);
+  if (it != props.end() && it->first == key)
   {
-    return handle_map(env);
+    return it->second;
   }
-  else if (m_head.isSymbol() && m_head.asSymbol() == "set-property")
-  {
-    return handle_setProp(env);
+  return none;
+}
+
+namespace {
+
+// the state owned by a lambda call: the lambda, which keeps its body alive,
+// and the frame its parameters are bound in
+struct Activation {
+  Expression lambda;
+  Environment scope;
+
+  Activation(const Expression & l, const Environment * parent): lambda(l), scope(parent){}
+
+  // every lambda call that is not a tail call creates one
+  static void * operator new(std::size_t size){
+    return PoolAllocator<Activation>().allocate(size / sizeof(Activation));
   }
-  else if (m_head.isSymbol() && m_head.asSymbol() == "get-property")
-  {
-    return handle_getProp(env);
+
+  static void operator delete(void * p){
+    PoolAllocator<Activation>().deallocate(static_cast<Activation *>(p), 1);
   }
-  else if (m_head.isSymbol() && m_head.asSymbol() == "discrete-plot")
-  {
-    return handle_discretePlot(env);
+};
+
+// an expression whose evaluation is in progress
+struct Continuation {
+  const Expression * exp;             // the expression being evaluated
+  Environment * env;                  // the environment it is evaluated in
+  std::size_t next;                   // the index of the next tail element to evaluate
+  std::size_t base;                   // the size of the value stack when it started
+  std::unique_ptr<Activation> call;   // set when exp is the body of a lambda
+
+  Continuation(const Expression * e, Environment * en): exp(e), env(en), next(0), base(0){}
+};
+
+// the value of next once a call has entered the body of a lambda
+const std::size_t RETURNED = static_cast<std::size_t>(-1);
+
+// the stacks of the evaluator. Nested evaluations on the same thread work
+// above the entries of the evaluations that started them, so the storage is
+// reused rather than allocated per call to eval.
+struct Machine {
+  std::vector<Continuation> stack;
+  std::vector<Expression> values;
+  std::vector<Expression> args;
+
+  // the procedure caches of call sites, indexed by call site number
+  std::vector<Environment::CallSiteCache> sites;
+
+  // the most continuations held at once since the last reset
+  std::size_t peak = 0;
+};
+
+thread_local Machine machine;
+
+// restores the stacks to their size on entry when an evaluation is abandoned
+struct Unwind {
+  std::size_t stack_size;
+  std::size_t values_size;
+
+  Unwind(): stack_size(machine.stack.size()), values_size(machine.values.size()){}
+
+  ~Unwind(){
+    machine.stack.erase(machine.stack.begin() + stack_size, machine.stack.end());
+    machine.values.erase(machine.values.begin() + values_size, machine.values.end());
   }
-  else if (m_head.isSymbol() && m_head.asSymbol() == "continuous-plot")
+};
+
+}
+
+std::size_t Expression::peakEvalDepth() noexcept{
+  return machine.peak;
+}
+
+void Expression::resetEvalDepth() noexcept{
+  machine.peak = 0;
+}
+
+// The evaluator is iterative: pending expressions are kept on a heap
+// allocated continuation stack and their values on a value stack, so the
+// depth of the AST and of nested lambda calls is bounded by memory rather
+// than by the native stack. Calls in tail position of a lambda body, or of
+// a begin in tail position, reuse the caller's frame and so run in constant
+// space. The plot and property forms, apply and map
+// evaluate their arguments through nested calls to eval.
+Expression Expression::eval(Environment & env) const{
+
+  if (global_status_flag > 0)
   {
-    return handle_continuousPlot(env);
+    throw SemanticError("Error: interpreter kernel interrupted");
+    //return Expression(Atom("Error: interpreter kernel interrupted"));
   }
-  // else attempt to treat as procedure
-  else{
-    std::vector<Expression> results;
-    for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
-      results.push_back(it->eval(env));
+
+  if(m_tail.empty()){
+    if (form() == ListForm)//check case for empty list
+    {
+      return Expression(m_tail.get());
     }
-    return apply(m_head, results, env);
+    return handle_lookup(m_head, env);
   }
+
+  std::vector<Continuation> & stack = machine.stack;
+  std::vector<Expression> & values = machine.values;
+  std::vector<Expression> & args = machine.args;
+  std::vector<Environment::CallSiteCache> & sites = machine.sites;
+  Unwind unwind;
+
+  // evaluate an expression directly if it does not need the stacks,
+  // otherwise schedule it
+  auto enter = [&stack, &values](Continuation && c){
+
+    if (global_status_flag > 0)
+    {
+      throw SemanticError("Error: interpreter kernel interrupted");
+    }
+
+    const Expression & exp = *c.exp;
+    Environment & cenv = *c.env;
+    Form f = exp.form();
+
+    if(exp.m_tail.empty()){
+      if (f == ListForm)//check case for empty list
+      {
+        values.emplace_back(exp.m_tail.get());
+      }
+      else{
+        values.push_back(exp.handle_lookup(exp.m_head, cenv));
+      }
+      return;
+    }
+
+    switch(f){
+    case BeginForm:
+      if(!exp.m_tail[0].isHeadSymbol()){
+        throw SemanticError("Error during evaluation: first argument to begin not symbol");
+      }
+      break;
+    case DefineForm:
+      {
+        if(exp.m_tail.size() != 2){
+          throw SemanticError("Error during evaluation: invalid number of arguments to define");
+        }
+        if(!exp.m_tail[0].isHeadSymbol()){
+          throw SemanticError("Error during evaluation: first argument to define not symbol");
+        }
+        Form g = exp.m_tail[0].form();
+        if((g == DefineForm) || (g == BeginForm) || (g == ApplyForm)){
+          throw SemanticError("Error during evaluation: attempt to redefine a special-form");
+        }
+      }
+      break;
+    case LambdaForm:
+      values.push_back(exp.handle_lambda(cenv));
+      return;
+    case ApplyForm:
+      values.push_back(exp.handle_apply(cenv));
+      return;
+    case MapForm:
+      values.push_back(exp.handle_map(cenv));
+      return;
+    case SetPropertyForm:
+      values.push_back(exp.handle_setProp(cenv));
+      return;
+    case GetPropertyForm:
+      values.push_back(exp.handle_getProp(cenv));
+      return;
+    case DiscretePlotForm:
+      values.push_back(exp.handle_discretePlot(cenv));
+      return;
+    case ContinuousPlotForm:
+      values.push_back(exp.handle_continuousPlot(cenv));
+      return;
+    default:
+      break;
+    }
+
+    c.base = values.size();
+    stack.push_back(std::move(c));
+    machine.peak = std::max(machine.peak, stack.size());
+  };
+
+  enter(Continuation(this, &env));
+
+  while(stack.size() > unwind.stack_size){
+
+    Continuation & c = stack.back();
+    const Expression & exp = *c.exp;
+
+    switch(exp.form()){
+    case BeginForm:
+      // evaluate each arg from tail, keeping only the last value
+      if(c.next == exp.m_tail.size()){
+        stack.pop_back();
+      }
+      else{
+        if(c.next > 0){
+          values.pop_back();
+        }
+        std::size_t i = c.next++;
+        if(c.next < exp.m_tail.size()){
+          enter(Continuation(&exp.m_tail[i], c.env));
+        }
+        else{
+          // the last arg is in tail position: it replaces the begin,
+          // taking over the lambda call the begin may be the body of
+          Continuation last(&exp.m_tail[i], c.env);
+          last.call = std::move(c.call);
+          stack.pop_back();
+          enter(std::move(last));
+        }
+      }
+      break;
+    case DefineForm:
+      if(c.next == 0){
+        c.next = 1;
+        enter(Continuation(&exp.m_tail[1], c.env));
+      }
+      else{
+        c.env->add_exp(exp.m_tail[0].head(), values.back());
+        stack.pop_back();
+      }
+      break;
+    default:
+      // the called lambda has left its value
+      if(c.next == RETURNED){
+        stack.pop_back();
+        break;
+      }
+
+      // evaluate the arguments of a procedure or lambda call
+      if(c.next < exp.m_tail.size()){
+        std::size_t i = c.next++;
+        enter(Continuation(&exp.m_tail[i], c.env));
+        break;
+      }
+
+      // most call sites always call the same built-in procedure
+      Procedure proc = nullptr;
+      std::uint32_t site = exp.m_tail.stored()->site;
+      if(site != ExpressionTail::NO_SITE){
+        if(site >= sites.size()){
+          sites.resize(site + 1);
+        }
+        proc = c.env->get_proc(exp.m_head, sites[site]);
+      }
+
+      // built-in procedures read their arguments in place on the value stack
+      if((proc != nullptr) || !c.env->is_exp(exp.m_head)){
+        ArgSpan span(values.data() + c.base, values.size() - c.base);
+        Expression result = (proc != nullptr) ? proc(span) : apply_procedure(exp.m_head, span, *c.env);
+        if(span.empty()){
+          values.push_back(std::move(result));
+        }
+        else{
+          // the result takes the place of the first argument
+          values[c.base] = std::move(result);
+          values.resize(c.base + 1);
+        }
+        stack.pop_back();
+        break;
+      }
+
+      args.assign(std::make_move_iterator(values.begin() + c.base), std::make_move_iterator(values.end()));
+      values.resize(c.base);
+
+      if(c.call){
+        // a call in tail position of a lambda body: the caller's frame is
+        // no longer needed except for lookups, so the parameters are rebound
+        // in it and the body replaces the call
+        Continuation body(std::move(c));
+        stack.pop_back();
+        body.call->lambda = body.env->get_exp(exp.m_head);
+        body.exp = &bind_lambda(body.call->lambda, args, body.call->scope);
+        body.next = 0;
+        enter(std::move(body));
+      }
+      else{
+        // the body is evaluated in a frame chained to the calling
+        // environment, which the call keeps alive until the body returns
+        c.next = RETURNED;
+        Continuation body(nullptr, nullptr);
+        body.call.reset(new Activation(c.env->get_exp(exp.m_head), c.env));
+        body.env = &body.call->scope;
+        body.exp = &bind_lambda(body.call->lambda, args, body.call->scope);
+        enter(std::move(body));
+      }
+    }
+  }
+
+  Expression result(std::move(values.back()));
+  values.pop_back();
+  return result;
 }
 
 
@@ -1249,6 +1943,22 @@ std::ostream & operator<<(std::ostream & out, const Expression & exp){
       out << exp.head();
       int counter = exp.tailSize()-1;
 
+      // print a packed list without building its elements
+      if (exp.isPackedList())
+      {
+        for (double d : exp.packedNumbers())
+        {
+          out << Expression(Atom(d));
+          if (counter != 0)
+          {
+            out << " ";
+            counter--;
+          }
+        }
+        out << ")";
+        return out;
+      }
+
       for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e){
         out << *e;
         if (counter != 0)
@@ -1291,7 +2001,19 @@ bool Expression::operator==(const Expression & exp) const noexcept{
 
   result = result && (m_tail.size() == exp.m_tail.size());
 
-  if(result){
+  // copies that still share their tail are equal without a traversal
+  if(result && (m_tail.stored() != exp.m_tail.stored())){
+
+    // packed lists compare their numbers as number atoms do
+    if(isPackedList() && exp.isPackedList()){
+      const std::vector<double> & left = packedNumbers();
+      const std::vector<double> & right = exp.packedNumbers();
+      for(std::size_t i = 0; result && (i < left.size()); ++i){
+        result = (Atom(left[i]) == Atom(right[i]));
+      }
+      return result;
+    }
+
     for(auto lefte = m_tail.begin(), righte = exp.m_tail.begin();
 	(lefte != m_tail.end()) && (righte != exp.m_tail.end());
 	++lefte, ++righte){
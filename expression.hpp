@@ -4,32 +4,122 @@ Defines the Expression type and assiciated functions.
 #ifndef EXPRESSION_HPP
 #define EXPRESSION_HPP
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <utility>
 #include <map>
+#include <mutex>
 #include <csignal>
 #include <cstdlib>
 
 #include "token.hpp"
 #include "atom.hpp"
+#include "copy_on_write.hpp"
 
 // forward declare Environment
 class Environment;
 
 extern volatile sig_atomic_t global_status_flag;
 
+class Expression;
+
+class Bytecode;
+
+/*! \class ExpressionTail
+\brief The tail of an Expression, which a list of numbers may store packed.
+
+A packed tail keeps its numbers in a contiguous array and leaves the vector
+of elements empty until something reads the elements, when they are built
+once. Writing to a packed tail converts it to elements for good.
+ */
+class ExpressionTail : public std::vector<Expression> {
+public:
+
+  using std::vector<Expression>::operator=;
+
+  /// the packed numbers, empty unless the tail is packed
+  std::vector<double> numbers;
+
+  /*! The call site number of the procedure call owning this tail, or
+    NO_SITE. The number is released for reuse when the tail is destroyed,
+    so the numbers in use stay as few as the call sites alive.
+   */
+  std::uint32_t site = NO_SITE;
+
+  static const std::uint32_t NO_SITE = 0xFFFFFFFF;
+
+  /*! The compiled body of the lambda owning this tail, made by the
+    bytecode engine when the lambda is first called, so that it is freed
+    with the lambda.
+   */
+  mutable std::shared_ptr<const Bytecode> code;
+
+  /// guards the compilation of code
+  mutable std::once_flag compiled;
+
+  ExpressionTail() = default;
+
+  ~ExpressionTail();
+
+  /// build the elements of a packed tail, if not already built
+  void expand() const;
+
+private:
+
+  mutable std::once_flag expanded;
+};
+
+// reading a packed tail through the container interface builds its
+// elements, while its size is read without building them
+
+template<>
+const ExpressionTail & CopyOnWrite<ExpressionTail>::get() const noexcept;
+
+template<>
+ExpressionTail & CopyOnWrite<ExpressionTail>::edit();
+
+template<>
+CopyOnWrite<ExpressionTail>::size_type CopyOnWrite<ExpressionTail>::size() const noexcept;
+
+template<>
+bool CopyOnWrite<ExpressionTail>::empty() const noexcept;
+
 /*! \class Expression
 \brief An expression is a tree of Atoms.
 
 An expression is an atom called the head followed by a (possibly empty)
 list of expressions called the tail.
+
+The tail and the property map are shared between copies and only copied
+when one of the copies is modified, so copying an Expression is O(1).
  */
 class Expression {
 public:
 
   typedef std::vector<Expression>::const_iterator ConstIteratorType;
 
+  /*! \enum Form
+    \brief The special-form an expression evaluates as, determined by its head.
+
+    Forms are resolved once when the expression is parsed so evaluation can
+    dispatch with a single switch. Expressions built at run-time start as
+    UnresolvedForm and are resolved when first evaluated.
+   */
+  enum Form : unsigned char { UnresolvedForm,
+                              CallForm, //< procedure or lambda call
+                              ListForm, //< a call to list, or the empty list
+                              BeginForm,
+                              DefineForm,
+                              LambdaForm,
+                              ApplyForm,
+                              MapForm,
+                              SetPropertyForm,
+                              GetPropertyForm,
+                              DiscretePlotForm,
+                              ContinuousPlotForm
+  };
+
   /// Default construct and Expression, whose type in NoneType
   Expression();
 
@@ -38,14 +128,30 @@ public:
   */
   Expression(const Atom & a);
 
-  /// deep-copy construct an expression (recursive)
+  /// copy construct an expression, sharing its tail and properties
   Expression(const Expression & a);
 
+  /// move construct an expression, leaving a empty
+  Expression(Expression && a) noexcept;
+
+  /// destroy an expression, releasing deeply nested tails without recursion
+  ~Expression();
+
+  /// construct a list Expression with a copy of the elements of a
   Expression(const std::vector<Expression> & a);
 
-  /// deep-copy assign an expression  (recursive)
+  /// construct a list Expression taking ownership of the elements of a
+  Expression(std::vector<Expression> && a);
+
+  /// construct a list Expression of numbers, packed if it is long enough
+  explicit Expression(std::vector<double> && numbers);
+
+  /// assign an expression, sharing its tail and properties
   Expression & operator=(const Expression & a);
 
+  /// move assign an expression, leaving a empty
+  Expression & operator=(Expression && a) noexcept;
+
   /// return a reference to the head Atom
   Atom & head();
 
@@ -55,9 +161,40 @@ public:
   /// append Atom to tail of the expression
   void append(const Atom & a);
 
+  /// append the elements of a to tail of the expression, taking ownership of them
+  void append(std::vector<Expression> && a);
+
   /// return a pointer to the last expression in the tail, or nullptr
   Expression * tail();
 
+  /// resolve and store the special-form named by the head
+  void resolveForm() noexcept;
+
+  /// the special-form named by the head
+  Form form() const noexcept;
+
+  /*! Resolve references to lambda parameters and number call sites.
+
+    Each symbol leaf in the body of a lambda-form that names one of the
+    lambda's own parameters records the parameter's position, so that it
+    evaluates by reading the call frame directly instead of by name.
+    Symbols free in the body stay unresolved and are looked up by name.
+
+    Each procedure call is given a call site number, which identifies the
+    cache of the procedure it calls. The number belongs to the tail of the
+    call and is reused once no copy of the call is left.
+   */
+  void resolveReferences() noexcept;
+
+  /// the position of the lambda parameter this leaf refers to, or -1
+  int paramSlot() const noexcept;
+
+  /// the call site number of a procedure call, or -1
+  long callSite() const noexcept;
+
+  /// the tail shared by the copies of this expression, or nullptr if it is empty
+  const ExpressionTail * sharedTail() const noexcept;
+
   /// return a const-iterator to the beginning of tail
   ConstIteratorType tailConstBegin() const noexcept;
 
@@ -78,20 +215,43 @@ public:
 
   bool isHeadNone() const noexcept;
 
-  Expression handleMakePoint() const noexcept;
+  /*! Determine if the expression is a packed list.
+
+    A list of at least PACKED_SIZE plain numbers is stored as a contiguous
+    array of doubles. Its elements can still be read one by one, but they
+    are only built when first read that way.
+   */
+  bool isPackedList() const noexcept;
+
+  /// the numbers of a packed list, or an empty vector if it is not packed
+  const std::vector<double> & packedNumbers() const noexcept;
+
+  /// the least number of elements a packed list has
+  static const std::size_t PACKED_SIZE = 16;
+
+  /*! The most pending expressions the evaluator of the calling thread has
+    held at once since resetEvalDepth, which bounds the space evaluation
+    used.
+   */
+  static std::size_t peakEvalDepth() noexcept;
 
-  Expression handleMakeLine() const noexcept;
+  /// start measuring peakEvalDepth again
+  static void resetEvalDepth() noexcept;
 
-  Expression handleMakeText() const noexcept;
+  const Expression & handleMakePoint() const noexcept;
 
-  Expression handleRotation() const noexcept;
+  const Expression & handleMakeLine() const noexcept;
 
-  Expression handleScale() const noexcept;
+  const Expression & handleMakeText() const noexcept;
 
-  Expression searchMap() const noexcept;
+  const Expression & handleRotation() const noexcept;
+
+  const Expression & handleScale() const noexcept;
+
+  const Expression & searchMap() const noexcept;
 
   /// Evaluate expression using a post-order traversal (recursive)
-  Expression eval(Environment & env);
+  Expression eval(Environment & env) const;
 
   /// equality comparison for two expressions (recursive)
   bool operator==(const Expression & exp) const noexcept;
@@ -100,59 +260,103 @@ public:
 
   int getPropSize() const noexcept;
 
-  Expression getExpressionFirst() const noexcept;
+  /// return a const-reference to the first element of the tail
+  const Expression & getExpressionFirst() const noexcept;
 
-  Expression getTail(int location) const noexcept;
+  /// return a const-reference to the element of the tail at location
+  const Expression & getTail(int location) const noexcept;
 
-  void generateBoundingBoxLines(Expression & plotResult, double & scaledAU, double & scaledAL, double & scaledOU, double & scaledOL);
+  void generateBoundingBoxLines(Expression & plotResult, double & scaledAU, double & scaledAL, double & scaledOU, double & scaledOL) const;
 
-  void generateTextLabels(Expression & plotResult, Expression & evalText, double & scaledAU, double & scaledAL, double & scaledOL, double & scaledOU);
+  void generateTextLabels(Expression & plotResult, Expression & evalText, double & scaledAU, double & scaledAL, double & scaledOL, double & scaledOU) const;
 
-  void createStrings(double & au, double & al, double & ol, double & ou, double & scaledAU, double & scaledAL, double & scaledOL, double & scaledOU, Expression & plotResult);
+  void createStrings(double & au, double & al, double & ol, double & ou, double & scaledAU, double & scaledAL, double & scaledOL, double & scaledOU, Expression & plotResult) const;
 
-  void scalePointsLines(Expression & plotResult, Expression & evalText, Expression & evalPoints, double & au, double & al, double & ol, double & ou);
+  void scalePointsLines(Expression & plotResult, Expression & evalText, Expression & evalPoints, double & au, double & al, double & ol, double & ou) const;
 
-  void continuousBoundingBox(Expression & conPlotResult, double & scaledOL2, double & scaledOU2, double & scaledAL2, double & scaledAU2);
+  void continuousBoundingBox(Expression & conPlotResult, double & scaledOL2, double & scaledOU2, double & scaledAL2, double & scaledAU2) const;
 
-  void continuousTextLabels(Expression & conPlotResult, Expression & evalText, double & scaledOL2, double & scaledOU2, double & scaledAL2, double & scaledAU2);
+  void continuousTextLabels(Expression & conPlotResult, Expression & evalText, double & scaledOL2, double & scaledOU2, double & scaledAL2, double & scaledAU2) const;
 
-  void continuousCreateStrings(Expression & conPlotResult, double & au2, double & al2, double & ol2, double & ou2, double & scaledAU2, double & scaledAL2, double & scaledOL2, double & scaledOU2);
+  void continuousCreateStrings(Expression & conPlotResult, double & au2, double & al2, double & ol2, double & ou2, double & scaledAU2, double & scaledAL2, double & scaledOL2, double & scaledOU2) const;
 
-  void continuousAngleCalc(Expression & conPlotResult, std::vector<Expression> points, double & xscale, double & yscale, Environment & env);
+  void continuousAngleCalc(Expression & conPlotResult, std::vector<Expression> points, double & xscale, double & yscale, Environment & env) const;
 
-  std::vector<Expression> splitLine(Expression point1, Expression point2, Expression point3, double & xscale, double & yscale, Environment & env);
+  std::vector<Expression> splitLine(Expression point1, Expression point2, Expression point3, double & xscale, double & yscale, Environment & env) const;
 private:
 
   // the head of the expression
   Atom m_head;
 
   // the tail list is expressed as a vector for access efficiency
-  // and cache coherence, at the cost of wasted memory.
-  std::vector<Expression> m_tail;
+  // and cache coherence, shared copy-on-write between copies.
+  CopyOnWrite<ExpressionTail> m_tail;
+
+  // the special-form named by m_head, cached by resolveForm
+  Form m_form;
+
+  // the parameter position of a leaf, set by resolveReferences, or NO_SLOT
+  std::uint16_t m_slot;
+
+  static const std::uint16_t NO_SLOT = 0xFFFF;
 
   // convenience typedef
   typedef std::vector<Expression>::iterator IteratorType;
 
+  // pack a list of plain numbers if it is long enough, from a or its copy
+  bool pack(const std::vector<Expression> & a);
+
   // internal helper methods
-  Expression handle_lookup(const Atom & head, const Environment & env);
-  Expression handle_define(Environment & env);
-  Expression handle_begin(Environment & env);
-  Expression handle_lambda(Environment & env);
-  Expression handle_apply(Environment & env);
-  Expression handle_map(Environment & env);
-  Expression handle_setProp(Environment & env);
-  Expression handle_getProp(Environment & env);
-  Expression handle_discretePlot(Environment & env);
-  Expression handle_continuousPlot(Environment & env);
+  Expression handle_lookup(const Atom & head, const Environment & env) const;
+  Expression handle_define(Environment & env) const;
+  Expression handle_begin(Environment & env) const;
+  Expression handle_lambda(Environment & env) const;
+  Expression handle_apply(Environment & env) const;
+  Expression handle_map(Environment & env) const;
+  Expression handle_setProp(Environment & env) const;
+  Expression handle_getProp(Environment & env) const;
+  Expression handle_discretePlot(Environment & env) const;
+  Expression handle_continuousPlot(Environment & env) const;
 
   void handleApplyLambda(const std::vector<Expression> & arg, const std::vector<Expression> & input, Environment & env, const Expression & proc);
 
-  std::string round(double num);
-  bool checkAngle175(Expression point1, Expression point2, Expression point3);
+  std::string round(double num) const;
+  bool checkAngle175(Expression point1, Expression point2, Expression point3) const;
+
+  // the properties, sorted by the interned id of their key. They are shared
+  // copy-on-write and take no storage until one is set.
+  CopyOnWrite<std::vector<std::pair<SymbolTable::IdType, Expression>>> prop;
 
-  std::map<std::string, Expression> prop;
+  // set the property named by key, replacing any previous value
+  void setProperty(SymbolTable::IdType key, const Expression & value);
+
+  // the value of the property named by key, or a None expression if unset
+  const Expression & getProperty(SymbolTable::IdType key) const noexcept;
 };
 
+// reading the head is defined here so that it inlines into the procedures
+
+inline const Atom & Expression::head() const{
+  return m_head;
+}
+
+inline bool Expression::isHeadNumber() const noexcept{
+  return m_head.isNumber();
+}
+
+inline bool Expression::isHeadList() const noexcept{
+  return m_head.isList();//check if list
+}
+
+/*! Apply the procedure or lambda named by op to already evaluated arguments.
+  \param op the symbol naming the procedure or lambda
+  \param args the evaluated arguments
+  \param env the environment to call in
+  \return the result of the call
+  \throws SemanticError if op does not name a procedure or lambda
+ */
+Expression apply(const Atom & op, const std::vector<Expression> & args, const Environment & env);
+
 /// Render expression to output stream
 std::ostream & operator<<(std::ostream & out, const Expression & exp);
 
@@ -1,6 +1,11 @@
 #include "catch.hpp"
 
+#include <sstream>
+#include <string>
+
+#include "environment.hpp"
 #include "expression.hpp"
+#include "parse.hpp"
 
 TEST_CASE( "Test default expression", "[expression]" ) {
 
@@ -26,3 +31,122 @@ TEST_CASE( "Test symbol expression", "[expression]" ) {
   REQUIRE(!exp.isHeadNumber());
   REQUIRE(exp.isHeadSymbol());
 }
+
+TEST_CASE( "Test copies share the tail until modified", "[expression]" ) {
+
+  Expression exp(std::vector<Expression>{Expression(1.0), Expression(2.0)});
+  Expression copy = exp;
+
+  REQUIRE(copy == exp);
+  REQUIRE(&*copy.tailConstBegin() == &*exp.tailConstBegin());
+
+  copy.append(Atom(3.0));
+
+  REQUIRE(copy.tailSize() == 3);
+  REQUIRE(exp.tailSize() == 2);
+  REQUIRE(copy != exp);
+}
+
+TEST_CASE( "Test appending many elements at once", "[expression]" ) {
+
+  Expression exp(std::vector<Expression>{Expression(1.0)});
+  Expression copy = exp;
+
+  copy.append(std::vector<Expression>{Expression(2.0), Expression(Atom("a"))});
+  REQUIRE(copy.tailSize() == 3);
+  REQUIRE(copy.getTail(2) == Expression(Atom("a")));
+  REQUIRE(exp.tailSize() == 1);
+
+  // an empty tail takes the elements as they are
+  Expression list(Atom("list"));
+  list.append(std::vector<Expression>{Expression(1.0), Expression(2.0)});
+  REQUIRE(list.tailSize() == 2);
+  REQUIRE(list.getTail(0) == Expression(1.0));
+}
+
+TEST_CASE( "Test long lists of numbers are packed", "[expression]" ) {
+
+  std::vector<double> numbers;
+  std::vector<Expression> elements;
+  for(int i = 0; i < 20; ++i){
+    numbers.push_back(i);
+    elements.emplace_back(double(i));
+  }
+
+  Expression packed{std::vector<double>(numbers)};
+  REQUIRE(packed.isHeadList());
+  REQUIRE(packed.isPackedList());
+  REQUIRE(packed.tailSize() == 20);
+  REQUIRE(packed.packedNumbers() == numbers);
+
+  // a list of plain numbers is packed as it is built
+  Expression list(elements);
+  REQUIRE(list.isPackedList());
+  REQUIRE(list == packed);
+
+  // but not if it is short or any element is not a plain number
+  REQUIRE(!Expression(std::vector<double>{1, 2, 3}).isPackedList());
+  elements.back() = Expression(Atom("a"));
+  REQUIRE(!Expression(elements).isPackedList());
+
+  // the elements read the same as those of a list that is not packed
+  REQUIRE(packed.getTail(7) == Expression(7.0));
+  REQUIRE(packed.isPackedList());
+
+  // and modifying a copy converts only the copy to elements
+  Expression copy = packed;
+  copy.append(Atom(20.0));
+  REQUIRE(!copy.isPackedList());
+  REQUIRE(copy.tailSize() == 21);
+  REQUIRE(packed.tailSize() == 20);
+  REQUIRE(copy != packed);
+
+  std::ostringstream out;
+  out << Expression(std::vector<double>(16, 1.5));
+  REQUIRE(out.str() == "((1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5) (1.5))");
+}
+
+// parse and evaluate program with the tree-walking evaluator
+static Expression evaluate(const std::string & program){
+
+  std::istringstream iss(program);
+  Expression ast = parse(tokenize(iss));
+
+  // compared outside REQUIRE, which would print the whole AST
+  bool parsed = (ast != Expression());
+  REQUIRE(parsed);
+
+  Environment env;
+  return ast.eval(env);
+}
+
+TEST_CASE( "Test evaluation depth is not limited by the native stack", "[expression]" ) {
+
+  const int depth = 200000;
+
+  {
+    std::string program;
+    for(int i = 0; i < depth; ++i){
+      program += "(+ 1 ";
+    }
+    program += "0" + std::string(depth, ')');
+
+    REQUIRE(evaluate(program) == Expression(depth));
+  }
+
+  {
+    std::string program = "(begin (define f (lambda (x) (+ x 1))) ";
+    for(int i = 0; i < depth; ++i){
+      program += "(f ";
+    }
+    program += "0" + std::string(depth, ')') + ")";
+
+    REQUIRE(evaluate(program) == Expression(depth));
+  }
+}
+
+TEST_CASE( "Test lambda bodies that are calls", "[expression]" ) {
+
+  REQUIRE(evaluate("(begin (define f (lambda (x) (* x 2))) (define g (lambda (y) (f (+ y 1)))) (g 3))") == Expression(8));
+  REQUIRE(evaluate("(begin (define f (lambda (x) x)) (f 5))") == Expression(5));
+}
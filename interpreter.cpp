@@ -10,17 +10,61 @@
 #include "environment.hpp"
 #include "semantic_error.hpp"
 
+std::atomic<int> Interpreter::default_engine(TreeWalkEngine);
+
+Interpreter::Interpreter(): engine(static_cast<Engine>(default_engine.load())){}
+
+void Interpreter::setEngine(Engine e) noexcept{
+  engine = e;
+}
+
+void Interpreter::setDefaultEngine(Engine e) noexcept{
+  default_engine = e;
+}
+
 bool Interpreter::parseStream(std::istream & expression) noexcept{
 
-  TokenSequenceType tokens = tokenize(expression);
+  SourceBuffer source(expression);
+
+  return parseSource(source);
+};
 
-  ast = parse(tokens);
+bool Interpreter::parseSource(const SourceBuffer & source) noexcept{
+
+  ast = parse(source);
+  program.reset();
 
   return (ast != Expression());
-};
+}
+
+bool Interpreter::parseNext(StreamParser & parser) noexcept{
+
+  if(!parser.next(ast)){
+    return false;
+  }
+  program.reset();
+
+  return true;
+}
 				     
 
 Expression Interpreter::evaluate(){
 
+  if(engine == BytecodeEngine){
+    if(!program){
+      program.reset(new Bytecode(Bytecode::compile(ast, env)));
+    }
+    return vm.run(*program, env);
+  }
+
+  Expression::resetEvalDepth();
   return ast.eval(env);
 }
+
+std::size_t Interpreter::peakDepth() const noexcept{
+
+  if(engine == BytecodeEngine){
+    return vm.peakFrames();
+  }
+  return Expression::peakEvalDepth();
+}
@@ -8,12 +8,17 @@ It maintains an environment during evaluation.
 #define INTERPRETER_HPP
 
 // system includes
+#include <atomic>
 #include <istream>
+#include <memory>
 #include <string>
 
 // module includes
+#include "bytecode.hpp"
 #include "environment.hpp"
 #include "expression.hpp"
+#include "parse.hpp"
+#include "token.hpp"
 
 /*! \class Interpreter
 \brief Class to parse and evaluate an expression (program)
@@ -21,22 +26,59 @@ It maintains an environment during evaluation.
 Interpreter has an Environment, which starts at a default.
 The parse method builds an internal AST.
 The eval method updates Environment and returns last result.
+
+Evaluation uses either the tree-walking evaluator or the bytecode virtual
+machine. Both produce the same results and errors.
 */
 class Interpreter {
 public:
 
+  /*! \enum Engine
+    \brief The evaluation strategies available to evaluate.
+   */
+  enum Engine { TreeWalkEngine, //< recursively evaluate the AST
+                BytecodeEngine  //< compile the AST and run it on the VM
+  };
+
+  /// Construct an interpreter using the default engine
+  Interpreter();
+
+  /// Select the engine used by evaluate
+  void setEngine(Engine engine) noexcept;
+
+  /// Set the engine new interpreters start with
+  static void setDefaultEngine(Engine engine) noexcept;
+
   /*! Parse into an internal Expression from a stream
     \param expression the raw text stream repreenting the candidate expression
     \return true on successful parsing
    */
   bool parseStream(std::istream &expression) noexcept;
 
+  /*! Parse into an internal Expression from the characters of a buffer
+    \param source the characters of the candidate expression
+    \return true on successful parsing
+   */
+  bool parseSource(const SourceBuffer &source) noexcept;
+
+  /*! Take the next complete top-level expression of a program being fed
+    to a streaming parser as the internal Expression
+    \param parser the parser the program is fed to
+    \return true if an expression was ready
+   */
+  bool parseNext(StreamParser &parser) noexcept;
+
   /*! Evaluate the Expression by walking the tree, returning the result.
     \return the Expression resulting from the evaluation in the current environment
     \throws SemanticError when a semantic error is encountered
    */
   Expression evaluate();
 
+  /*! The most frames or pending expressions the selected engine held at
+    once during the last evaluate, which bounds the space it used.
+   */
+  std::size_t peakDepth() const noexcept;
+
 private:
 
   // the environment
@@ -44,6 +86,17 @@ private:
 
   // the AST
   Expression ast;
+
+  // the selected engine
+  Engine engine;
+
+  // the AST compiled for the bytecode engine, built on first evaluation
+  std::unique_ptr<Bytecode> program;
+
+  // the virtual machine for the bytecode engine
+  VirtualMachine vm;
+
+  static std::atomic<int> default_engine;
 };
 
 #endif
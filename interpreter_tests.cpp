@@ -1,5 +1,6 @@
 #include "catch.hpp"
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <fstream>
@@ -1063,6 +1064,100 @@ TEST_CASE( "Testing list procedures: range", "[interpreter]" ) {
 
 }
 
+TEST_CASE( "Testing list procedures on packed lists", "[interpreter]" ) {
+
+  Expression numbers = run("(range 1 100 1)");
+  REQUIRE(numbers.isPackedList());
+
+  REQUIRE(run("(length (range 1 100 1))") == Expression(100));
+  REQUIRE(run("(first (range 1 100 1))") == Expression(1));
+  REQUIRE(run("(first (rest (range 1 100 1)))") == Expression(2));
+  REQUIRE(run("(length (rest (range 1 100 1)))") == Expression(99));
+  REQUIRE(run("(length (rest (range 1 16 1)))") == Expression(15));
+
+  Expression doubled = run("(begin (define f (lambda (x) (* 2 x))) (map f (range 1 100 1)))");
+  REQUIRE(doubled.isPackedList());
+  REQUIRE(doubled.tailSize() == 100);
+  REQUIRE(doubled.getTail(99) == Expression(200));
+
+  Expression joined = run("(join (range 1 50 1) (range 51 100 1))");
+  REQUIRE(joined.isPackedList());
+  bool same = (joined == numbers);
+  REQUIRE(same);
+
+  Expression appended = run("(append (range 1 99 1) 100)");
+  REQUIRE(appended.isPackedList());
+  same = (appended == numbers);
+  REQUIRE(same);
+
+  // anything but a number makes a list of elements
+  Expression mixed = run("(append (range 1 99 1) (list I))");
+  REQUIRE(!mixed.isPackedList());
+  REQUIRE(mixed.getTail(98) == Expression(99));
+  REQUIRE(mixed.getTail(99) == Expression(std::complex<double>(0, 1)));
+}
+
+TEST_CASE( "Testing element-wise arithmetic and math over lists", "[interpreter]" ) {
+
+  REQUIRE(run("(+ (list 1 2 3) 1)") == run("(list 2 3 4)"));
+  REQUIRE(run("(- 10 (list 1 2 3))") == run("(list 9 8 7)"));
+  REQUIRE(run("(* (list 1 2 3) (list 4 5 6) 2)") == run("(list 8 20 36)"));
+  REQUIRE(run("(/ (list 1 2 4))") == run("(list 1 0.5 0.25)"));
+  REQUIRE(run("(- (list 1 (list 2 3)))") == run("(list -1 (list -2 -3))"));
+  REQUIRE(run("(^ (list 1 2 3) 2)") == run("(list 1 4 9)"));
+  REQUIRE(run("(+ (list 1 2) I)") == run("(list (+ 1 I) (+ 2 I))"));
+  REQUIRE(run("(sqrt (list 4 -4))") == run("(list 2 (* 2 I))"));
+  REQUIRE(run("(real (list (+ 1 I) (- 2 I)))") == run("(list 1 2)"));
+  REQUIRE(run("(conj (list (+ 1 I)))") == run("(list (- 1 I))"));
+  REQUIRE(run("(sin (list))") == run("(list)"));
+
+  // apply passes each argument by its head alone, so a nested list becomes
+  // the empty list named list, which broadcasts to the empty list. Before
+  // broadcasting, + skipped list arguments and this gave 3.
+  REQUIRE(run("(+ (list) 3)") == run("(list)"));
+  REQUIRE(run("(apply + (list (list 1 2) 3))") == run("(list)"));
+
+  // long lists of numbers are computed from their packed numbers
+  Expression shifted = run("(+ (range 0 999 1) 1)");
+  REQUIRE(shifted.isPackedList());
+  REQUIRE(shifted.tailSize() == 1000);
+  REQUIRE(shifted.getTail(999) == Expression(1000));
+
+  bool same = (run("(sin (range 0 10 0.1))") == run("(map sin (range 0 10 0.1))"));
+  REQUIRE(same);
+  same = (run("(- (* 3 (range 0 99 1)) (+ (range 0 99 1) (range 0 99 1) (range 0 99 1)))") == run("(* 0 (range 0 99 1))"));
+  REQUIRE(same);
+  same = (run("(sqrt (range -20 20 1))") == run("(map sqrt (range -20 20 1))"));
+  REQUIRE(same);
+
+  std::vector<std::string> programs = {"(+ (list 1 2) (list 1 2 3))",
+                                       "(ln (range -20 20 1))",
+                                       "(sin (list 1 I))",
+                                       "(real (range 0 20 1))"};
+  for(auto s : programs){
+    Interpreter interp;
+    std::istringstream iss(s);
+    REQUIRE(interp.parseStream(iss));
+    REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+  }
+}
+
+TEST_CASE( "Testing binary arithmetic on reals and complexes", "[interpreter]" ) {
+
+  REQUIRE(run("(+ 1.5 2)") == Expression(3.5));
+  REQUIRE(run("(- 1.5 2)") == Expression(-0.5));
+  REQUIRE(run("(* 1.5 2)") == Expression(3.0));
+  REQUIRE(run("(/ 1.5 2)") == Expression(0.75));
+  REQUIRE(run("(^ 1.5 2)") == Expression(2.25));
+
+  // a complex operand on either side selects complex arithmetic
+  REQUIRE(run("(+ 1 I)") == Expression(std::complex<double>(1, 1)));
+  REQUIRE(run("(- I 1)") == Expression(std::complex<double>(-1, 1)));
+  REQUIRE(run("(* 2 I)") == Expression(std::complex<double>(0, 2)));
+  REQUIRE(run("(/ I 2)") == Expression(std::complex<double>(0, 0.5)));
+  REQUIRE(run("(^ I 2)") == Expression(std::pow(std::complex<double>(0, 1), 2.0)));
+}
+
 TEST_CASE( "Testing lambda basics", "[interpreter]" ) {
   std::string program = "(begin (define a 1) (define x 100) (define f (lambda (x) (begin (define b 12) (+ a b x)))) (f 2))";
 
@@ -1073,6 +1168,122 @@ TEST_CASE( "Testing lambda basics", "[interpreter]" ) {
 
 }
 
+TEST_CASE( "Testing tail calls keep dynamic scope", "[interpreter]" ) {
+  std::string program = "(begin (define g (lambda (y) (+ x y))) (define f (lambda (x) (begin (define z 5) (g z)))) (f 10))";
+
+  Expression result = run(program);
+
+  REQUIRE(result == Expression(15));
+}
+
+TEST_CASE( "Testing parameters resolved by position", "[interpreter]" ) {
+
+  // a repeated parameter name is bound to its last argument
+  REQUIRE(run("(begin (define f (lambda (x x) x)) (f 1 2))") == Expression(2));
+
+  // redefining a parameter in the body replaces its binding
+  REQUIRE(run("(begin (define f (lambda (x) (begin (define x (+ x 1)) x))) (f 1))") == Expression(2));
+
+  // inner parameters shadow outer ones, and free names stay dynamic
+  REQUIRE(run("(begin (define g (lambda (x) (+ x y))) (define f (lambda (x y) (g (* x 10)))) (f 1 2))") == Expression(12));
+
+  // a tail call to a lambda with the same parameters in another order
+  REQUIRE(run("(begin (define g (lambda (y x) (- x y))) (define f (lambda (x y) (g x y))) (f 1 5))") == Expression(4));
+}
+
+TEST_CASE( "Testing call site caches follow redefinitions", "[interpreter]" ) {
+
+  // a frame binding the name of a built-in shadows the cached procedure
+  REQUIRE(run("(begin (define h (lambda (x) (+ x 1))) (define g (lambda (+) (h 2))) (list (h 1) (g (lambda (a b) (- a b))) (h 1)))") ==
+          Expression(std::vector<Expression>{Expression(2), Expression(1), Expression(2)}));
+
+  // so does a later definition at the top level
+  REQUIRE(run("(begin (define h (lambda (x) (+ x 1))) (define a (h 1)) (define + (lambda (a b) (* a b))) (list a (h 3)))") ==
+          Expression(std::vector<Expression>{Expression(2), Expression(3)}));
+}
+
+TEST_CASE( "Testing a tail recursive loop", "[interpreter]" ) {
+
+  // the loop ends when ln is called with a negative argument, after as many
+  // calls as its first argument
+  auto loop = [](int n, std::size_t & depth){
+    std::string s = "(begin (define loop (lambda (n) (begin (ln n) (loop (- n 1))))) (loop " +
+      std::to_string(n) + "))";
+
+    Interpreter interp;
+    std::istringstream iss(s);
+    REQUIRE(interp.parseStream(iss));
+
+    std::string error;
+    try{
+      interp.evaluate();
+    }
+    catch(const SemanticError & ex){
+      error = ex.what();
+    }
+    depth = interp.peakDepth();
+    return error;
+  };
+
+  std::size_t short_depth = 0;
+  std::size_t long_depth = 0;
+  REQUIRE(loop(10, short_depth) == "Error in call to naturalLog, argument is negative");
+  REQUIRE(loop(100000, long_depth) == "Error in call to naturalLog, argument is negative");
+
+  // each call replaces the one before, so the loop runs in constant space
+  REQUIRE(short_depth > 0);
+  REQUIRE(long_depth == short_depth);
+
+  // also when each pass defines and calls a lambda, whose compiled body is
+  // freed with it
+  auto closures = [](int n, std::size_t & depth, std::size_t & compiled){
+    std::string s = "(begin (define loop (lambda (n) (begin (define f (lambda (x) (ln x))) (f n) (loop (- n 1))))) (loop " +
+      std::to_string(n) + "))";
+
+    Interpreter interp;
+    std::istringstream iss(s);
+    REQUIRE(interp.parseStream(iss));
+
+    std::string error;
+    try{
+      interp.evaluate();
+    }
+    catch(const SemanticError & ex){
+      error = ex.what();
+    }
+    depth = interp.peakDepth();
+    compiled = VirtualMachine::compiledLambdas();
+    return error;
+  };
+
+  std::size_t before = VirtualMachine::compiledLambdas();
+  std::size_t short_compiled = 0;
+  std::size_t long_compiled = 0;
+  REQUIRE(closures(10, short_depth, short_compiled) == "Error in call to naturalLog, argument is negative");
+  REQUIRE(closures(100000, long_depth, long_compiled) == "Error in call to naturalLog, argument is negative");
+  REQUIRE(long_depth == short_depth);
+  REQUIRE(long_compiled == short_compiled);
+  REQUIRE(VirtualMachine::compiledLambdas() == before);
+}
+
+TEST_CASE( "Testing compiled lambdas are freed with the lambda", "[interpreter]" ) {
+
+  std::size_t before = VirtualMachine::compiledLambdas();
+
+  // each input defines and calls a new lambda, as a REPL session does
+  Interpreter interp;
+  std::size_t most = 0;
+  for(int i = 0; i < 1000; ++i){
+    std::istringstream iss("(begin (define f (lambda (x) (+ x " + std::to_string(i) + "))) (f 1))");
+    REQUIRE(interp.parseStream(iss));
+    REQUIRE(interp.evaluate() == Expression(1.0 + i));
+    most = std::max(most, VirtualMachine::compiledLambdas());
+  }
+
+  // only the lambdas still bound, or held by the last program, keep a body
+  REQUIRE(most <= before + 2);
+}
+
 TEST_CASE( "Testing apply basics", "[interpreter]" ) {
   std::string program = "(begin (define complexAsList (lambda (x) (list (real x) (imag x)))) (apply complexAsList (list (+ 1 (* 3 I)))))";
 
@@ -1195,6 +1406,53 @@ TEST_CASE( "throwing errors for map part 3", "[interpreter]" ) {
   REQUIRE(result3 == Expression(result));
 }
 
+TEST_CASE( "Testing map pipelines over ranges", "[interpreter]" ) {
+
+  // a map over a range or another map gives the same list as building each
+  REQUIRE(run("(begin (define f (lambda (x) (* x x))) (map f (range 1 3 1)))") == run("(list 1 4 9)"));
+  REQUIRE(run("(begin (define f (lambda (x) (+ x 1))) (map f (map - (range 1 3 1))))") == run("(list 0 -1 -2)"));
+  REQUIRE(run("(begin (define r (range 1 3 1)) (define f (lambda (x) (- x))) (map sqrt (map f r)))") ==
+          run("(list I (sqrt -2) (sqrt -3))"));
+  bool same = (run("(map sin (range 0 2 0.1))") == run("(begin (define r (range 0 2 0.1)) (map sin r))"));
+  REQUIRE(same);
+
+  // a range that is not the built-in is called as usual
+  REQUIRE(run("(begin (define range (lambda (x) (list x x))) (map - (range 2)))") == run("(list -2 -2)"));
+
+  std::vector<std::string> programs = {"(map - (range 3 1 1))",
+                                       "(map - (range 1 3 0))",
+                                       "(map - (range 1 3))",
+                                       "(map 3 (range 1 3 1))",
+                                       "(map - (map 3 (list 1 2)))",
+                                       "(map 3 (map - 3))"};
+  for(auto s : programs){
+    Interpreter interp;
+    std::istringstream iss(s);
+    REQUIRE(interp.parseStream(iss));
+    REQUIRE_THROWS_AS(interp.evaluate(), SemanticError);
+  }
+
+  // the inner map runs over every element before the outer one starts, so
+  // the first error raised is the same as with the maps run one by one
+  auto error = [](const std::string & program){
+    Interpreter interp;
+    std::istringstream iss(program);
+    REQUIRE(interp.parseStream(iss));
+    std::string message;
+    try{
+      interp.evaluate();
+    }
+    catch(const SemanticError & ex){
+      message = ex.what();
+    }
+    return message;
+  };
+  REQUIRE(error("(map first (map ln (list 1 -1)))") == "Error in call to naturalLog, argument is negative");
+  REQUIRE(error("(map first (map ln (range -1 1 1)))") == "Error in call to naturalLog, argument is negative");
+  REQUIRE(error("(map 3 (map ln (list 1 -1)))") == "Error in call to naturalLog, argument is negative");
+  REQUIRE(error("(map first (map - (list 1 2)))") == "Error: argument to first is not a list");
+}
+
 TEST_CASE( "throwing rand", "[interpreter]" ) {
   std::string s = "(length 1 2)";
 
@@ -1482,6 +1740,14 @@ std::string s = "(begin (define a (+ 1 I)) (define b (set-property \"note\" \"co
 
 }
 
+TEST_CASE( "set-property on a copy", "[interpreter]" ) {
+  std::string s = "(begin (define a (set-property \"note\" 1 2)) (define b (set-property \"note\" 3 a)) (define c (set-property \"other\" 4 b)) (list (get-property \"note\" a) (get-property \"note\" c) (get-property \"other\" c) (get-property \"other\" b)))";
+
+  std::vector<Expression> result = {Expression(1), Expression(3), Expression(4), Expression()};
+
+  REQUIRE(run(s) == Expression(result));
+}
+
 TEST_CASE( "throwing errors for properties", "[interpreter]" ) {
   std::vector<std::string> programs = {"(get-property \"number\" \"three\" (3))", "(get-property (+ 2 3) \"number\")", "(begin)", "(set-property \"note\" \"complex\" a (3))"};
 
@@ -1539,6 +1805,30 @@ TEST_CASE( "testing continuous3", "[interpreter]" ) {
 
 }
 
+TEST_CASE( "Test Interpreter evaluating expressions as they are parsed", "[interpreter]" ) {
+
+  Interpreter interp;
+  StreamParser parser;
+
+  std::string first = "(define a 2)\n(define f (lambda (x)\n";
+  parser.feed(first.data(), first.size());
+
+  // the first definition is evaluated before the rest has been read
+  REQUIRE(interp.parseNext(parser));
+  REQUIRE(interp.evaluate() == Expression(2.));
+  REQUIRE(!interp.parseNext(parser));
+
+  std::string second = "  (* a x)))\n(f 21)";
+  parser.feed(second.data(), second.size());
+  REQUIRE(parser.finish());
+
+  REQUIRE(interp.parseNext(parser));
+  interp.evaluate();
+  REQUIRE(interp.parseNext(parser));
+  REQUIRE(interp.evaluate() == Expression(42.));
+  REQUIRE(!interp.parseNext(parser));
+}
+
 void worker(ThreadSafeQueue<std::string> & myq)
 {
   for (int i = 0; i < 10; i++)
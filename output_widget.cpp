@@ -36,14 +36,14 @@ void OutputWidget::onExpiration()
     {
       //std::cout << result.first << std::endl;
       //instead of cout, grab the expression to check
-      Expression exp = result.first;
+      const Expression & exp = result.first;
 
       if (exp.getPropSize() != 0)//is a point, line, or text
       {
-        Expression property = exp.searchMap();
+        const Expression & property = exp.searchMap();
         if (property.head().asSymbol() == "\"point\"")//its point
         {
-          Expression size = exp.handleMakePoint();
+          const Expression & size = exp.handleMakePoint();
           scene->addEllipse(exp.getTail(0).head().asNumber()-(size.head().asNumber()/2),
                             exp.getTail(1).head().asNumber()-(size.head().asNumber()/2),
                             size.head().asNumber(),size.head().asNumber(),
@@ -52,16 +52,16 @@ void OutputWidget::onExpiration()
         }
         else if (property.head().asSymbol() == "\"line\"")//its line
         {
-          Expression thickness = exp.handleMakeLine();
+          const Expression & thickness = exp.handleMakeLine();
           QPen line;
           line.setWidth(thickness.head().asNumber());
           scene->addLine(exp.getTail(0).getTail(0).head().asNumber(), exp.getTail(0).getTail(1).head().asNumber(), exp.getTail(1).getTail(0).head().asNumber(), exp.getTail(1).getTail(1).head().asNumber(), line);
         }
         else //its text
         {
-          Expression position = exp.handleMakeText();
-          Expression scale = exp.handleScale();
-          Expression rotation = exp.handleRotation();
+          const Expression & position = exp.handleMakeText();
+          const Expression & scale = exp.handleScale();
+          const Expression & rotation = exp.handleRotation();
           string withoutQuotes = exp.head().asSymbol();
           withoutQuotes.erase(0,1);
           withoutQuotes.erase(withoutQuotes.size()-1);
@@ -85,10 +85,10 @@ void OutputWidget::onExpiration()
         {
           for (auto it = exp.tailConstBegin(); it != exp.tailConstEnd(); ++it)
           {
-            Expression property = (*it).searchMap();
+            const Expression & property = (*it).searchMap();
             if (property.head().asSymbol() == "\"point\"")//its point
             {
-              Expression size = (*it).handleMakePoint();
+              const Expression & size = (*it).handleMakePoint();
               scene->addEllipse((*it).getTail(0).head().asNumber()-(size.head().asNumber()/2),
                                 (*it).getTail(1).head().asNumber()-(size.head().asNumber()/2),
                                 size.head().asNumber(),size.head().asNumber(),
@@ -97,16 +97,16 @@ void OutputWidget::onExpiration()
             }
             else if (property.head().asSymbol() == "\"line\"")//its line
             {
-              Expression thickness = (*it).handleMakeLine();
+              const Expression & thickness = (*it).handleMakeLine();
               QPen line;
               line.setWidth(thickness.head().asNumber());
               scene->addLine((*it).getTail(0).getTail(0).head().asNumber(), (*it).getTail(0).getTail(1).head().asNumber(), (*it).getTail(1).getTail(0).head().asNumber(), (*it).getTail(1).getTail(1).head().asNumber(), line);
             }
             else if (property.head().asSymbol() == "\"text\"") //its text
             {
-              Expression position = (*it).handleMakeText();
-              Expression scale = (*it).handleScale();
-              Expression rotation = (*it).handleRotation();
+              const Expression & position = (*it).handleMakeText();
+              const Expression & scale = (*it).handleScale();
+              const Expression & rotation = (*it).handleRotation();
               string withoutQuotes = (*it).head().asSymbol();
               withoutQuotes.erase(0,1);
               withoutQuotes.erase(withoutQuotes.size()-1);
@@ -196,14 +196,14 @@ void OutputWidget::onOutput(Interpreter &interp, std::string expression, bool &
       {
         //std::cout << result.first << std::endl;
         //instead of cout, grab the expression to check
-        Expression exp = result.first;
+        const Expression & exp = result.first;
 
         if (exp.getPropSize() != 0)//is a point, line, or text
         {
-          Expression property = exp.searchMap();
+          const Expression & property = exp.searchMap();
           if (property.head().asSymbol() == "\"point\"")//its point
           {
-            Expression size = exp.handleMakePoint();
+            const Expression & size = exp.handleMakePoint();
             scene->addEllipse(exp.getTail(0).head().asNumber()-(size.head().asNumber()/2),
                               exp.getTail(1).head().asNumber()-(size.head().asNumber()/2),
                               size.head().asNumber(),size.head().asNumber(),
@@ -212,16 +212,16 @@ void OutputWidget::onOutput(Interpreter &interp, std::string expression, bool &
           }
           else if (property.head().asSymbol() == "\"line\"")//its line
           {
-            Expression thickness = exp.handleMakeLine();
+            const Expression & thickness = exp.handleMakeLine();
             QPen line;
             line.setWidth(thickness.head().asNumber());
             scene->addLine(exp.getTail(0).getTail(0).head().asNumber(), exp.getTail(0).getTail(1).head().asNumber(), exp.getTail(1).getTail(0).head().asNumber(), exp.getTail(1).getTail(1).head().asNumber(), line);
           }
           else //its text
           {
-            Expression position = exp.handleMakeText();
-            Expression scale = exp.handleScale();
-            Expression rotation = exp.handleRotation();
+            const Expression & position = exp.handleMakeText();
+            const Expression & scale = exp.handleScale();
+            const Expression & rotation = exp.handleRotation();
             string withoutQuotes = exp.head().asSymbol();
             withoutQuotes.erase(0,1);
             withoutQuotes.erase(withoutQuotes.size()-1);
@@ -245,10 +245,10 @@ void OutputWidget::onOutput(Interpreter &interp, std::string expression, bool &
           {
             for (auto it = exp.tailConstBegin(); it != exp.tailConstEnd(); ++it)
             {
-              Expression property = (*it).searchMap();
+              const Expression & property = (*it).searchMap();
               if (property.head().asSymbol() == "\"point\"")//its point
               {
-                Expression size = (*it).handleMakePoint();
+                const Expression & size = (*it).handleMakePoint();
                 scene->addEllipse((*it).getTail(0).head().asNumber()-(size.head().asNumber()/2),
                                   (*it).getTail(1).head().asNumber()-(size.head().asNumber()/2),
                                   size.head().asNumber(),size.head().asNumber(),
@@ -257,16 +257,16 @@ void OutputWidget::onOutput(Interpreter &interp, std::string expression, bool &
               }
               else if (property.head().asSymbol() == "\"line\"")//its line
               {
-                Expression thickness = (*it).handleMakeLine();
+                const Expression & thickness = (*it).handleMakeLine();
                 QPen line;
                 line.setWidth(thickness.head().asNumber());
                 scene->addLine((*it).getTail(0).getTail(0).head().asNumber(), (*it).getTail(0).getTail(1).head().asNumber(), (*it).getTail(1).getTail(0).head().asNumber(), (*it).getTail(1).getTail(1).head().asNumber(), line);
               }
               else if (property.head().asSymbol() == "\"text\"") //its text
               {
-                Expression position = (*it).handleMakeText();
-                Expression scale = (*it).handleScale();
-                Expression rotation = (*it).handleRotation();
+                const Expression & position = (*it).handleMakeText();
+                const Expression & scale = (*it).handleScale();
+                const Expression & rotation = (*it).handleRotation();
                 string withoutQuotes = (*it).head().asSymbol();
                 withoutQuotes.erase(0,1);
                 withoutQuotes.erase(withoutQuotes.size()-1);
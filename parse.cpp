@@ -1,108 +1,653 @@
 #include "parse.hpp"
 
-#include <stack>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 using std::endl;
 using std::cout;
 
-bool setHead(Expression &exp, const Token &token) {
-
-  Atom a(token);
+bool setHead(Expression &exp, const Atom &a) {
 
   exp.head() = a;
+  exp.resolveForm();
 
   return !a.isNone();
 }
 
-bool append(Expression *exp, const Token &token) {
-
-  Atom a(token);
+bool append(Expression *exp, const Atom &a) {
 
   exp->append(a);
+  exp->tail()->resolveForm();
 
   return !a.isNone();
 }
 
-Expression parse(const TokenSequenceType &tokens) noexcept {
+FormBuilder::FormBuilder() noexcept: athead(false) {}
 
-  Expression ast;
+FormBuilder::Status FormBuilder::open() noexcept {
 
-  // cannot parse empty
-  if (tokens.empty())
-    return Expression();
+  athead = true;
+  return Building;
+}
 
-  bool athead = false;
-  bool atString = false;
+FormBuilder::Status FormBuilder::close() noexcept {
 
-  // stack tracks the last node created
-  std::stack<Expression *> stack;
+  if (stack.empty())
+  {
+    return Invalid;
+  }
+  stack.pop_back();
 
-  std::size_t num_tokens_seen = 0;
+  return stack.empty() ? Complete : Building;
+}
 
-  for (auto &t : tokens) {
-    if (t.type() == Token::OPEN) {
-      athead = true;
+FormBuilder::Status FormBuilder::atom(const Atom &a) noexcept {
+
+  if (athead) {
+    if (stack.empty())
+    {
+      if (!setHead(ast, a))
+      {
+        return Invalid;
+      }
+
+      stack.push_back(&ast);
     }
-    else if (t.type() == Token::CLOSE)
+    else
     {
-      if (stack.empty())
+      if (!append(stack.back(), a))
       {
+        return Invalid;
+      }
+      stack.push_back(stack.back()->tail());
+    }
+    athead = false;
+  }
+  else
+  {
+    if (stack.empty())
+    {
+      return Invalid;
+    }
+
+    if (!append(stack.back(), a))
+    {
+      return Invalid;
+    }
+  }
+
+  return Building;
+}
+
+FormBuilder::Status FormBuilder::atoms(std::vector<Expression> &&elements) noexcept {
+
+  for (const Expression &e : elements) {
+    if (e.isHeadNone()) {
+      return Invalid;
+    }
+  }
+
+  // the first may be the head of a form just opened
+  if (athead && !elements.empty()) {
+    if (atom(elements.front().head()) == Invalid) {
+      return Invalid;
+    }
+    elements.erase(elements.begin());
+  }
+
+  if (stack.empty()) {
+    return elements.empty() ? Building : Invalid;
+  }
+  stack.back()->append(std::move(elements));
+
+  return Building;
+}
+
+bool FormBuilder::building() const noexcept {
+  return athead || !stack.empty();
+}
+
+Expression FormBuilder::take() noexcept {
+
+  ast.resolveReferences();
+  Expression result(std::move(ast));
+  ast = Expression();
+
+  return result;
+}
+
+// add a token to form, where atom makes the Atom of a string token
+template<typename TokenKind, typename MakeAtom>
+static FormBuilder::Status add_token(FormBuilder &form, const TokenKind &t, MakeAtom &atom) noexcept {
+
+  if (t.type() == Token::OPEN) {
+    return form.open();
+  }
+  else if (t.type() == Token::CLOSE) {
+    return form.close();
+  }
+  return form.atom(atom(t));
+}
+
+struct BlockToken;
+
+// add a token produced by BlockTokens to form
+template<typename MakeAtom>
+static FormBuilder::Status add_token(FormBuilder &form, const BlockToken &t, MakeAtom &atom) noexcept;
+
+// parse the tokens produced by next, which returns a pointer to the next
+// token or nullptr when there are none left, as a program of exactly one
+// expression. Tokens may be produced as they are consumed.
+template<typename Next, typename MakeAtom>
+static Expression parse_tokens(Next next, MakeAtom atom) noexcept {
+
+  // cannot parse empty
+  auto t = next();
+  if (t == nullptr)
+    return Expression();
+
+  FormBuilder form;
+
+  do {
+    FormBuilder::Status status = add_token(form, *t, atom);
+    if (status == FormBuilder::Invalid) {
+      return Expression();
+    }
+
+    // the program ends with the form that closes the first one
+    if (status == FormBuilder::Complete) {
+      if (next() != nullptr) {
         return Expression();
       }
-      stack.pop();
+      return form.take();
+    }
+  } while ((t = next()) != nullptr);
+
+  return Expression();
+}
+
+// produces the tokens of a sequence, in order
+template<typename Tokens>
+struct SequenceTokens {
+  typename Tokens::const_iterator it;
+  typename Tokens::const_iterator end;
+
+  const typename Tokens::value_type *operator()() {
+    return (it != end) ? &*it++ : nullptr;
+  }
+};
 
-      if (stack.empty()) {
-        num_tokens_seen += 1;
-        break;
+// parse the characters of a buffer as they are scanned, as parse_tokens
+// does. The atoms of a form other than its head are made into a vector as
+// they are scanned and added to the form a run at a time, which costs less
+// than adding them one by one.
+static Expression parse_scanned(const char *text, std::size_t size) noexcept {
+
+  Tokenizer tokenizer(text, size);
+  TokenView t;
+
+  // cannot parse empty
+  if (!tokenizer.next(t))
+    return Expression();
+
+  auto atom = [text](const TokenView &t) { return Atom(text + t.offset(), t.length()); };
+
+  FormBuilder form;
+  std::vector<Expression> run;
+  bool athead = false;
+
+  do {
+    if (t.type() == Token::STRING && !athead) {
+      run.emplace_back(atom(t));
+      run.back().resolveForm();
+      continue;
+    }
+
+    if (!run.empty() && form.atoms(std::move(run)) == FormBuilder::Invalid) {
+      return Expression();
+    }
+    run.clear();
+
+    athead = (t.type() == Token::OPEN);
+    FormBuilder::Status status = add_token(form, t, atom);
+    if (status == FormBuilder::Invalid) {
+      return Expression();
+    }
+
+    // the program ends with the form that closes the first one
+    if (status == FormBuilder::Complete) {
+      if (tokenizer.next(t)) {
+        return Expression();
       }
+      return form.take();
     }
-    else
-    {
-      if (athead) {
-        if (stack.empty())
-        {
-          if (!setHead(ast, t))
-          {
-            return Expression();
-          }
+  } while (tokenizer.next(t));
 
-          stack.push(&ast);
-        }
-        else
-        {
-          if (stack.empty())
-          {
-            return Expression();
-          }
+  return Expression();
+}
+
+// the least number of characters in a run of atoms converted in parallel,
+// and the size of the chunks the run is split into
+static const std::size_t PARALLEL_RUN = 1 << 18;
+static const std::size_t PARALLEL_CHUNK = 1 << 16;
+
+// the threads worth asking for to parse size characters, at most one for
+// each chunk they could be split into
+static unsigned chunk_threads(unsigned threads, std::size_t size) noexcept {
+  return static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(threads, size / PARALLEL_CHUNK)));
+}
+
+// threads that help make the atoms of long runs, started when first needed
+// and kept waiting for the next run, so a run does not pay for starting
+// threads. It serves one run at a time; a run started while another is
+// being served is made on its calling thread alone.
+class WorkerPool {
+public:
+
+  static WorkerPool &instance() {
+    // worker threads wait in it until the program ends, so never destroyed
+    static WorkerPool *pool = new WorkerPool();
+    return *pool;
+  }
+
+  // call work on the calling thread and on up to helpers workers at once,
+  // and return once every call has returned
+  void run(unsigned helpers, const std::function<void()> &work) noexcept {
 
-          if (!append(stack.top(), t))
-          {
-            return Expression();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (job == nullptr) {
+        // a worker that cannot be started only costs parallelism
+        while (workers.size() < helpers) {
+          try {
+            workers.emplace_back(&WorkerPool::serve, this);
+          }
+          catch (const std::system_error &) {
+            break;
           }
-          stack.push(stack.top()->tail());
         }
-        athead = false;
+        job = &work;
+        wanted = std::min<std::size_t>(helpers, workers.size());
       }
-      else
-      {
-        if (stack.empty())
-        {
-          return Expression();
-        }
+      else {
+        helpers = 0;
+      }
+    }
 
-        if (!append(stack.top(), t))
-        {
-          return Expression();
-        }
+    if (helpers > 0) {
+      wake.notify_all();
+    }
+    work();
+    if (helpers == 0) {
+      return;
+    }
+
+    // workers that have not joined yet are not needed any more
+    std::unique_lock<std::mutex> lock(mutex);
+    wanted = 0;
+    done.wait(lock, [this]() { return busy == 0; });
+    job = nullptr;
+  }
+
+private:
+
+  void serve() {
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [this]() { return wanted > 0; });
+      --wanted;
+      ++busy;
+      const std::function<void()> &work = *job;
+      lock.unlock();
+      work();
+      lock.lock();
+      if (--busy == 0) {
+        done.notify_all();
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::vector<std::thread> workers;
+
+  // the run being served, the workers still to join it, and the workers
+  // calling it
+  const std::function<void()> *job = nullptr;
+  std::size_t wanted = 0;
+  std::size_t busy = 0;
+};
+
+// make the elements of chunks holding only atoms, chunk i lying from
+// bounds[i] to bounds[i + 1] in text, on up to threads threads, and
+// return them in order
+static std::vector<Expression> convert_chunks(const char *text, const std::vector<std::size_t> &bounds,
+                                              unsigned threads) noexcept {
+
+  std::size_t count = bounds.size() - 1;
+  std::vector<std::vector<Expression>> chunks(count);
+
+  std::atomic<std::size_t> next(0);
+  std::function<void()> work = [text, &bounds, &chunks, &next, count]() {
+    std::size_t i;
+    while ((i = next++) < count) {
+      const char *chunk = text + bounds[i];
+      Tokenizer tokenizer(chunk, bounds[i + 1] - bounds[i]);
+      TokenView token;
+      while (tokenizer.next(token)) {
+        chunks[i].emplace_back(Atom(chunk + token.offset(), token.length()));
+        chunks[i].back().resolveForm();
       }
     }
-    num_tokens_seen += 1;
-  }//end for
+  };
 
-  if (stack.empty() && (num_tokens_seen == tokens.size())) {
-    return ast;
+  // the calling thread works too
+  WorkerPool::instance().run(static_cast<unsigned>(std::min<std::size_t>(threads, count)) - 1, work);
+
+  // spliced into storage of the final size, which a form can take as it is
+  std::size_t total = 0;
+  for (auto &c : chunks) {
+    total += c.size();
+  }
+  std::vector<Expression> elements;
+  elements.reserve(total);
+  for (auto &c : chunks) {
+    elements.insert(elements.end(), std::make_move_iterator(c.begin()), std::make_move_iterator(c.end()));
+    std::vector<Expression>().swap(c);
   }
 
-  return Expression();
+  return elements;
+}
+
+// a token, or the elements made ahead of time from a run of tokens
+struct BlockToken : TokenView {
+  std::vector<Expression> *elements;
 };
+
+template<typename MakeAtom>
+static FormBuilder::Status add_token(FormBuilder &form, const BlockToken &t, MakeAtom &atom) noexcept {
+
+  if (t.elements != nullptr) {
+    return form.atoms(std::move(*t.elements));
+  }
+  return add_token<TokenView>(form, t, atom);
+}
+
+// produces the tokens of a block of characters as they are scanned. Unless
+// the block is the last, scanning stops before a token that reaches its
+// end, which the next block may continue. With more than one thread, a run
+// of at least PARALLEL_RUN characters holding only atoms, such as the
+// elements of a large list literal, is split into chunks whose elements are
+// made on all of them, and the elements are then produced together.
+struct BlockTokens {
+
+  BlockTokens(const char *text, std::size_t size, bool last, unsigned threads) noexcept
+    : tokenizer(text, size), text(text), size(size), last(last), threads(threads),
+      stopped(size), end(0), delimiter(0), pending(false) {}
+
+  const BlockToken *operator()() noexcept {
+
+    if (pending) {
+      pending = false;
+      token.elements = &elements;
+      return &token;
+    }
+
+    TokenView view;
+    if (!tokenizer.next(view)) {
+      return nullptr;
+    }
+
+    if (view.type() == Token::STRING) {
+      if (!last && (view.offset() + view.length() == size)) {
+        stopped = view.offset();
+        return nullptr;
+      }
+      if ((threads > 1) && convert_run(view.offset())) {
+        return (*this)();
+      }
+    }
+
+    static_cast<TokenView &>(token) = view;
+    token.elements = nullptr;
+    end = view.offset() + view.length();
+    return &token;
+  }
+
+  // make the elements of the run starting at start ahead of time if it is
+  // long enough, and continue scanning after it
+  bool convert_run(std::size_t start) noexcept {
+
+    if (delimiter <= start) {
+      delimiter = tokenizer.next_delimiter(start);
+    }
+    if (delimiter - start < PARALLEL_RUN) {
+      return false;
+    }
+
+    // chunks end at white space
+    bounds.assign(1, start);
+    while (bounds.back() < delimiter) {
+      std::size_t bound = tokenizer.next_space(std::min(bounds.back() + PARALLEL_CHUNK, delimiter));
+      bounds.push_back(std::min(bound, delimiter));
+    }
+
+    // the last chunk of a block may end inside a token
+    if (!last && (delimiter == size)) {
+      bounds.pop_back();
+      if (bounds.size() < 2) {
+        return false;
+      }
+    }
+
+    elements = convert_chunks(text, bounds, threads);
+    pending = true;
+
+    static_cast<TokenView &>(token) = TokenView(Token::STRING, start, 0);
+    end = bounds.back();
+    tokenizer.seek(end);
+
+    return true;
+  }
+
+  Tokenizer tokenizer;
+  const char *text;
+  std::size_t size;
+  bool last;
+  unsigned threads;
+
+  // where scanning stopped, and the end of the last token
+  std::size_t stopped;
+  std::size_t end;
+
+  // the end of the last run looked at
+  std::size_t delimiter;
+
+  // the bounds of the chunks of the current run, and its elements while
+  // they are pending
+  std::vector<std::size_t> bounds;
+  std::vector<Expression> elements;
+  bool pending;
+
+  BlockToken token;
+};
+
+Expression parse(const TokenSequenceType &tokens) noexcept {
+
+  return parse_tokens(SequenceTokens<TokenSequenceType>{tokens.begin(), tokens.end()},
+                      [](const Token &t) { return Atom(t); });
+}
+
+Expression parse(const SourceBuffer &source, const TokenViewSequenceType &tokens) noexcept {
+
+  const char *text = source.data();
+  return parse_tokens(SequenceTokens<TokenViewSequenceType>{tokens.begin(), tokens.end()},
+                      [text](const TokenView &t) { return Atom(text + t.offset(), t.length()); });
+}
+
+Expression parse(const SourceBuffer &source) noexcept {
+
+  return parse(source, 1);
+}
+
+Expression parse(const SourceBuffer &source, unsigned threads) noexcept {
+
+  const char *text = source.data();
+  threads = chunk_threads(threads, source.size());
+
+  // only a buffer holding a long run of atoms is worth looking at
+  if ((threads > 1) && (source.size() >= PARALLEL_RUN)) {
+    return parse_tokens(BlockTokens(text, source.size(), true, threads),
+                        [text](const TokenView &t) { return Atom(text + t.offset(), t.length()); });
+  }
+
+  return parse_scanned(text, source.size());
+}
+
+StreamParser::StreamParser() noexcept: StreamParser(1) {}
+
+StreamParser::StreamParser(unsigned threads) noexcept: threads(threads), failed(false) {}
+
+bool StreamParser::feed(const char *data, std::size_t size) noexcept {
+
+  if (failed) {
+    return false;
+  }
+
+  if (carry.empty()) {
+    scan(data, size, false);
+  }
+  else {
+    block.assign(carry);
+    block.append(data, size);
+    carry.clear();
+    scan(block.data(), block.size(), false);
+  }
+
+  return !failed;
+}
+
+bool StreamParser::finish() noexcept {
+
+  if (!failed && !carry.empty()) {
+    block.swap(carry);
+    carry.clear();
+    scan(block.data(), block.size(), true);
+  }
+  carry.clear();
+
+  if (builder.building()) {
+    failed = true;
+  }
+
+  return !failed;
+}
+
+bool StreamParser::next(Expression &exp) noexcept {
+
+  if (ready.empty()) {
+    return false;
+  }
+
+  exp = std::move(ready.front());
+  ready.pop_front();
+
+  return true;
+}
+
+bool StreamParser::incomplete() const noexcept {
+
+  // a comment split by a block does not belong to an expression
+  return builder.building() || (!carry.empty() && carry[0] != ';');
+}
+
+bool StreamParser::invalid() const noexcept {
+  return failed;
+}
+
+void StreamParser::scan(const char *data, std::size_t size, bool last) noexcept {
+
+  auto atom = [data](const TokenView &t) { return Atom(data + t.offset(), t.length()); };
+
+  BlockTokens tokens(data, size, last, chunk_threads(threads, size));
+  while (const BlockToken *token = tokens()) {
+    FormBuilder::Status status = add_token(builder, *token, atom);
+    if (status == FormBuilder::Invalid) {
+      failed = true;
+      return;
+    }
+    if (status == FormBuilder::Complete) {
+      ready.push_back(builder.take());
+    }
+  }
+
+  if (last) {
+    return;
+  }
+
+  // the next block may continue the token
+  if (tokens.stopped < size) {
+    carry.assign(data + tokens.stopped, size - tokens.stopped);
+    return;
+  }
+
+  // only space and comments follow the last token, so a comment character
+  // after the last newline starts a comment the next block continues
+  std::size_t comment = size;
+  for (std::size_t i = size; (i > tokens.end) && (data[i - 1] != '\n'); --i) {
+    if (data[i - 1] == ';') {
+      comment = i - 1;
+    }
+  }
+  carry.assign(data + comment, size - comment);
+}
+
+FormScanner::FormScanner() noexcept : position(0), depth(0), quoted(false), failed(false) {}
+
+void FormScanner::scan(const std::string &text) noexcept {
+
+  Tokenizer tokenizer(text.data(), text.size());
+  tokenizer.seek(position);
+  quoted = false;
+
+  TokenView t;
+  while (tokenizer.next(t)) {
+    if (t.type() == Token::OPEN) {
+      ++depth;
+    }
+    else if (t.type() == Token::CLOSE) {
+      if (depth == 0) {
+        failed = true;
+      }
+      else {
+        --depth;
+      }
+    }
+    else if (t.offset() + t.length() == text.size() &&
+             std::count(text.data() + t.offset(), text.data() + text.size(), '"') % 2 == 1) {
+      // a quotation runs on past the end of the line, it is scanned again
+      // once the text has grown
+      quoted = true;
+      position = t.offset();
+      return;
+    }
+  }
+  position = text.size();
+}
+
+bool FormScanner::incomplete() const noexcept {
+  return (depth > 0) || quoted;
+}
+
+bool FormScanner::invalid() const noexcept {
+  return failed;
+}
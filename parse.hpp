@@ -4,15 +4,224 @@ Defines the parse function.
 #ifndef PARSE_HPP
 #define PARSE_HPP
 
+#include <deque>
+#include <string>
+#include <vector>
+
 #include "token.hpp"
 #include "expression.hpp"
 
 /*! \fn parse
 \brief parse a sequence of tokens into an expression (abstract syntax tree)
 
+References to lambda parameters in the result are resolved to parameter
+positions, see Expression::resolveReferences.
+
 \param tokens, the input token sequence
 \returns the expression resulting from parsing or the None Expression on failure
  */
 Expression parse(const TokenSequenceType & tokens) noexcept;
 
+/*! \fn parse
+\brief parse a sequence of token views into an expression (abstract syntax tree)
+
+\param source, the characters the tokens refer to
+\param tokens, the input token sequence
+\returns the expression resulting from parsing or the None Expression on failure
+ */
+Expression parse(const SourceBuffer & source, const TokenViewSequenceType & tokens) noexcept;
+
+/*! \fn parse
+\brief parse the characters of a buffer into an expression (abstract syntax tree)
+
+The characters are tokenized as they are parsed, so no sequence of tokens
+is built. Only the calling thread is used, see
+parse(const SourceBuffer &, unsigned) to use more.
+
+\param source, the characters of the program
+\returns the expression resulting from parsing or the None Expression on failure
+ */
+Expression parse(const SourceBuffer & source) noexcept;
+
+/*! \fn parse
+\brief parse the characters of a buffer into an expression (abstract syntax
+tree) using up to threads threads
+
+A run of at least 256 KiB holding only atoms, such as the elements of a
+large list literal, is split at white space into chunks whose atoms are
+made in parallel, and then added to the expression in order. Anything
+else is parsed on the calling thread. The threads other than the calling
+one are started the first time they are needed and kept for later runs.
+
+\param source, the characters of the program
+\param threads, the most threads to use, of which no more than one per
+64 KiB of source are used
+\returns the expression resulting from parsing or the None Expression on failure
+ */
+Expression parse(const SourceBuffer & source, unsigned threads) noexcept;
+
+/*! \class FormBuilder
+\brief Builds one top-level expression from tokens given one at a time.
+
+The tokens are the OPEN and CLOSE tokens and the Atoms of the STRING
+tokens, in order. Only the expression being built and the stack of its
+open forms are held.
+ */
+class FormBuilder {
+public:
+
+  /*! \enum Status
+    \brief The state of the expression after a token.
+   */
+  enum Status { Building, //< the expression needs more tokens
+                Complete, //< the token closed the expression
+                Invalid   //< the token cannot appear here
+  };
+
+  /// construct a builder waiting for the first token of an expression
+  FormBuilder() noexcept;
+
+  FormBuilder(const FormBuilder &) = delete;
+  FormBuilder & operator=(const FormBuilder &) = delete;
+
+  /// add an OPEN token
+  Status open() noexcept;
+
+  /// add a CLOSE token
+  Status close() noexcept;
+
+  /// add the Atom of a STRING token
+  Status atom(const Atom & a) noexcept;
+
+  /*! Add the Atoms of consecutive STRING tokens, each as the Expression
+    made from it with its special-form resolved, taking ownership of them.
+   */
+  Status atoms(std::vector<Expression> && elements) noexcept;
+
+  /// return true if tokens of an unfinished expression have been added
+  bool building() const noexcept;
+
+  /*! Take the expression after Complete, with references to lambda
+    parameters resolved, and wait for the first token of the next one.
+   */
+  Expression take() noexcept;
+
+private:
+  Expression ast;
+
+  // the forms opened and not yet closed, innermost last
+  std::vector<Expression *> stack;
+
+  // the last token was OPEN
+  bool athead;
+};
+
+/*! \class StreamParser
+\brief Parses a program given in blocks of characters, yielding each
+top-level expression as soon as its closing parenthesis has been fed.
+
+A program is a sequence of top-level expressions. The blocks may split a
+token or a comment anywhere, so a file or a terminal can be fed as it is
+read. Once invalid input has been fed the parser accepts nothing more,
+but the expressions completed before it can still be taken.
+ */
+class StreamParser {
+public:
+
+  /// construct a parser at the start of a program, using only the calling
+  /// thread
+  StreamParser() noexcept;
+
+  /*! Construct a parser at the start of a program.
+    \param threads the most threads to make the atoms of a long run with,
+    as parse(const SourceBuffer &, unsigned) does within a block
+   */
+  explicit StreamParser(unsigned threads) noexcept;
+
+  /*! Parse the next block of characters of the program.
+    \param data the first character of the block
+    \param size the number of characters in the block
+    \return false if the program is invalid
+   */
+  bool feed(const char * data, std::size_t size) noexcept;
+
+  /*! Signal the end of the program.
+    \return false if the program is invalid or ends inside an expression
+   */
+  bool finish() noexcept;
+
+  /*! Take the next complete expression, in program order.
+    \param exp set to the expression
+    \return true if there was one
+   */
+  bool next(Expression & exp) noexcept;
+
+  /// return true if characters of an unfinished expression have been fed
+  bool incomplete() const noexcept;
+
+  /// return true if invalid input has been fed
+  bool invalid() const noexcept;
+
+private:
+
+  // parse the tokens of a block. Unless it is the last, a token or comment
+  // that reaches the end of the block is kept to be continued by the next.
+  void scan(const char * data, std::size_t size, bool last) noexcept;
+
+  FormBuilder builder;
+
+  // the complete expressions not yet taken
+  std::deque<Expression> ready;
+
+  // the start of a token or comment split by the end of the last block
+  std::string carry;
+
+  // the carry followed by the next block
+  std::string block;
+
+  unsigned threads;
+
+  bool failed;
+};
+
+/*! \class FormScanner
+\brief Finds where the top-level expressions of a program end, without
+parsing them.
+
+The text of the program grows a line at a time, as a terminal is read. Only
+the new characters are tokenized, counting how deep the parentheses are
+open, with quotations and comments skipped as the parser skips them, so
+nothing is built and the text is read about once.
+ */
+class FormScanner {
+public:
+
+  /// construct a scanner at the start of a program
+  FormScanner() noexcept;
+
+  /*! Scan the characters of text added since the last scan.
+    \param text all the characters of the program so far, ending at the end
+    of a line
+   */
+  void scan(const std::string & text) noexcept;
+
+  /// return true if an expression or quotation is open at the end of text
+  bool incomplete() const noexcept;
+
+  /// return true if a parenthesis was closed that was not open
+  bool invalid() const noexcept;
+
+private:
+
+  // where to continue scanning, the start of a quotation still open
+  std::size_t position;
+
+  // the number of parentheses open
+  std::size_t depth;
+
+  bool quoted;
+
+  bool failed;
+};
+
 #endif
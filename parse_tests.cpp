@@ -1,5 +1,12 @@
 #include "catch.hpp"
 
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "parse.hpp"
 
 TEST_CASE("Test parser with expected input", "[parse]") {
@@ -57,3 +64,332 @@ TEST_CASE( "Test empty parens", "[parse]" ) {
   REQUIRE(parse(tokens) == Expression());
 }
 
+
+TEST_CASE( "Test special forms are resolved when parsed", "[parse]" ) {
+
+  std::string program = "(begin (define f (lambda (x) (list x))) (map f (list 1)))";
+
+  std::istringstream iss(program);
+
+  TokenSequenceType tokens = tokenize(iss);
+  Expression ast = parse(tokens);
+
+  REQUIRE(ast.form() == Expression::BeginForm);
+  REQUIRE(ast.getTail(0).form() == Expression::DefineForm);
+  REQUIRE(ast.getTail(0).getTail(1).form() == Expression::LambdaForm);
+  REQUIRE(ast.getTail(1).form() == Expression::MapForm);
+  REQUIRE(ast.getTail(1).getTail(0).form() == Expression::CallForm);
+  REQUIRE(ast.getTail(1).getTail(1).form() == Expression::ListForm);
+}
+
+TEST_CASE( "Test lambda parameters are resolved when parsed", "[parse]" ) {
+
+  std::string program = "(begin (define a 1) (lambda (x y) (+ y a (lambda (y) (+ x y)))))";
+
+  std::istringstream iss(program);
+
+  TokenSequenceType tokens = tokenize(iss);
+  Expression ast = parse(tokens);
+
+  REQUIRE(ast.getTail(0).getTail(0).paramSlot() == -1);
+
+  const Expression & body = ast.getTail(1).getTail(1);
+  REQUIRE(body.getTail(0).paramSlot() == 1);
+  REQUIRE(body.getTail(1).paramSlot() == -1);
+
+  // a nested lambda only resolves its own parameters
+  const Expression & inner = body.getTail(2).getTail(1);
+  REQUIRE(inner.getTail(0).paramSlot() == -1);
+  REQUIRE(inner.getTail(1).paramSlot() == 0);
+
+  // procedure calls are numbered, special-forms are not
+  REQUIRE(ast.callSite() == -1);
+  REQUIRE(body.callSite() >= 0);
+  REQUIRE(inner.callSite() >= 0);
+  REQUIRE(inner.callSite() != body.callSite());
+}
+
+TEST_CASE( "Test call site numbers are reused", "[parse]" ) {
+
+  auto sites_of = [](const std::string & program){
+    std::istringstream iss(program);
+    Expression ast = parse(tokenize(iss));
+    std::set<long> sites = {ast.callSite(), ast.getTail(0).callSite(), ast.getTail(1).callSite()};
+    return sites;
+  };
+
+  std::set<long> sites = sites_of("(+ (* 1 2) (- 3 4))");
+  REQUIRE(sites.size() == 3);
+  REQUIRE(sites.count(-1) == 0);
+
+  // once the calls are gone their numbers are handed out again, so parsing
+  // over and over does not use up the numbering
+  bool same = true;
+  for(int i = 0; i < 10000; ++i){
+    same = same && (sites_of("(+ (* 1 2) (- 3 4))") == sites);
+  }
+  REQUIRE(same);
+}
+
+TEST_CASE( "Test parse token views", "[parse]" ) {
+
+  std::vector<std::string> programs = {"(begin (define r 10) (* pi (* r r)))",
+                                       "(list \"a string\" -1.5e3 I (lambda (x) (+ x 1)))",
+                                       "((begin (+ 1))))))",
+                                       "(define a 1.2abc)",
+                                       "+ 1 2",
+                                       "()",
+                                       "(a ((b) c)",
+                                       "(a ()",
+                                       "(",
+                                       ""};
+
+  for(auto program : programs){
+    std::istringstream tokens_in(program);
+    Expression expected = parse(tokenize(tokens_in));
+
+    std::istringstream source_in(program);
+    SourceBuffer source(source_in);
+    Expression ast = parse(source, tokenize(source));
+
+    // compared outside REQUIRE, which would print the whole AST
+    bool same = (ast == expected);
+    REQUIRE(same);
+
+    // as does parsing the characters directly
+    Expression fused = parse(source);
+    same = (fused == expected);
+    REQUIRE(same);
+  }
+}
+
+// parse a program of one expression from a string
+static Expression parse_text(const std::string & program){
+  std::istringstream in(program);
+  SourceBuffer source(in);
+  return parse(source);
+}
+
+// feed a program to a parser in blocks of at most size characters, taking
+// the expressions as they become ready
+static std::vector<Expression> parse_blocks(const std::string & program, std::size_t size, bool & valid){
+
+  StreamParser parser;
+  std::vector<Expression> forms;
+  Expression exp;
+
+  valid = true;
+  for(std::size_t offset = 0; offset < program.size(); offset += size){
+    valid = parser.feed(program.data() + offset, std::min(size, program.size() - offset)) && valid;
+    while(parser.next(exp)){
+      forms.push_back(exp);
+    }
+  }
+  valid = parser.finish() && valid;
+  while(parser.next(exp)){
+    forms.push_back(exp);
+  }
+  return forms;
+}
+
+TEST_CASE( "Test streaming parser", "[parse]" ) {
+
+  {
+    INFO("each expression is ready when its closing paren is fed");
+    StreamParser parser;
+    std::string first = "(define a 1) (+ a";
+    REQUIRE(parser.feed(first.data(), first.size()));
+
+    Expression exp;
+    REQUIRE(parser.next(exp));
+    bool same = (exp == parse_text("(define a 1)"));
+    REQUIRE(same);
+    REQUIRE(!parser.next(exp));
+    REQUIRE(parser.incomplete());
+
+    std::string second = "\n 2)";
+    REQUIRE(parser.feed(second.data(), second.size()));
+    REQUIRE(parser.next(exp));
+    same = (exp == parse_text("(+ a 2)"));
+    REQUIRE(same);
+    REQUIRE(!parser.incomplete());
+    REQUIRE(parser.finish());
+    REQUIRE(!parser.next(exp));
+  }
+
+  {
+    INFO("blocks may split tokens, quotations and comments anywhere");
+    std::string program = "(begin (define r 10.25) ; a comment (not code)\n"
+                          "(* pi (* r r)))\n"
+                          "(list \"a (string)\" -1.5e3 I)\n"
+                          "(lambda (x) (+ x 1)) ; trailing comment";
+    std::vector<std::string> expected = {"(begin (define r 10.25) (* pi (* r r)))",
+                                         "(list \"a (string)\" -1.5e3 I)",
+                                         "(lambda (x) (+ x 1))"};
+
+    for(std::size_t size = 1; size <= program.size(); ++size){
+      bool valid;
+      std::vector<Expression> forms = parse_blocks(program, size, valid);
+      REQUIRE(valid);
+      REQUIRE(forms.size() == expected.size());
+      for(std::size_t i = 0; i < forms.size(); ++i){
+        bool same = (forms[i] == parse_text(expected[i]));
+        REQUIRE(same);
+      }
+    }
+  }
+
+  {
+    INFO("invalid input stops the parser after the expressions before it");
+    bool valid;
+    std::vector<Expression> forms = parse_blocks("(+ 1 2) )(+ 3 4)", 3, valid);
+    REQUIRE(!valid);
+    REQUIRE(forms.size() == 1);
+
+    forms = parse_blocks("(+ 1 2) 3", 4, valid);
+    REQUIRE(!valid);
+    REQUIRE(forms.size() == 1);
+
+    forms = parse_blocks("(define a 1.2abc)", 5, valid);
+    REQUIRE(!valid);
+    REQUIRE(forms.empty());
+  }
+
+  {
+    INFO("a program may not end inside an expression");
+    bool valid;
+    std::vector<Expression> forms = parse_blocks("(+ 1 2) (+ 3", 2, valid);
+    REQUIRE(!valid);
+    REQUIRE(forms.size() == 1);
+
+    // but may end in a comment, or be empty
+    forms = parse_blocks("(+ 1 2) ; end", 2, valid);
+    REQUIRE(valid);
+    REQUIRE(forms.size() == 1);
+
+    forms = parse_blocks("", 1, valid);
+    REQUIRE(valid);
+    REQUIRE(forms.empty());
+  }
+
+  {
+    INFO("a comment split by a block is not an unfinished expression");
+    StreamParser parser;
+    std::string line = "(+ 1 2) ; com";
+    parser.feed(line.data(), line.size());
+    REQUIRE(!parser.incomplete());
+  }
+}
+
+TEST_CASE( "Test scanning for the end of expressions", "[parse]" ) {
+
+  // the scanner is given the text so far, a line at a time
+  auto scan = [](const std::vector<std::string> & lines){
+    FormScanner scanner;
+    std::string text;
+    std::vector<bool> incomplete;
+    for(const auto & line : lines){
+      text += line + "\n";
+      scanner.scan(text);
+      incomplete.push_back(scanner.incomplete());
+    }
+    return incomplete;
+  };
+
+  REQUIRE(scan({"(+ 1 2)"}) == std::vector<bool>({false}));
+  REQUIRE(scan({"pi"}) == std::vector<bool>({false}));
+  REQUIRE(scan({"(begin", "(define a 1)", "a)"}) == std::vector<bool>({true, true, false}));
+
+  // parentheses in quotations and comments are not counted
+  REQUIRE(scan({"(list \"(\" ; (", "\")\")"}) == std::vector<bool>({true, false}));
+  REQUIRE(scan({"; (", "(+ 1 ; )", "2)"}) == std::vector<bool>({false, true, false}));
+
+  // a quotation may span lines
+  REQUIRE(scan({"(list \"a", "(b", "c\" 1)"}) == std::vector<bool>({true, true, false}));
+  REQUIRE(scan({"\"a", "b\""}) == std::vector<bool>({true, false}));
+
+  FormScanner scanner;
+  scanner.scan("(+ 1 2))\n");
+  REQUIRE(!scanner.incomplete());
+  REQUIRE(scanner.invalid());
+}
+
+TEST_CASE( "Test parallel parsing of long runs of atoms", "[parse]" ) {
+
+  // a large list literal between other forms, with symbols among the
+  // numbers, and a quotation splitting it into two runs parsed in parallel
+  std::string program = "(begin (define f (lambda (x) (* 2 x))) (define data (list";
+  for(std::size_t i = 0; i < 60000; ++i){
+    program += (i == 30000) ? " \"text\"" : "";
+    program += (i % 997 == 0) ? " sym " : " ";
+    program += std::to_string(i * 0.25 - 1000.5);
+    program += (i % 5003 == 0) ? "\n" : "";
+  }
+  program += ")) (f (first data)))";
+  REQUIRE(program.size() > (std::size_t(1) << 19));
+
+  std::istringstream in(program);
+  SourceBuffer source(in);
+  Expression expected = parse(source, 1);
+  REQUIRE(expected != Expression());
+
+  {
+    INFO("the result does not depend on the number of threads");
+    for(unsigned threads : {2u, 3u, 8u}){
+      Expression ast = parse(source, threads);
+      bool same = (ast == expected);
+      REQUIRE(same);
+    }
+  }
+
+  {
+    INFO("the worker threads are kept for later parses");
+    bool same = true;
+    for(int i = 0; i < 10; ++i){
+      same = same && (parse(source, 4) == expected);
+    }
+    REQUIRE(same);
+  }
+
+  {
+    INFO("nor on parses made at the same time");
+    bool same = true;
+    std::thread other([&source, &expected, &same](){
+      for(int i = 0; i < 5; ++i){
+        same = same && (parse(source, 4) == expected);
+      }
+    });
+    bool here = true;
+    for(int i = 0; i < 5; ++i){
+      here = here && (parse(source, 4) == expected);
+    }
+    other.join();
+    REQUIRE(same);
+    REQUIRE(here);
+  }
+
+  {
+    INFO("nor on the blocks a program is fed in");
+    for(std::size_t size : {std::size_t(100003), std::size_t(1) << 18, program.size()}){
+      StreamParser parser(4);
+      for(std::size_t offset = 0; offset < program.size(); offset += size){
+        REQUIRE(parser.feed(program.data() + offset, std::min(size, program.size() - offset)));
+      }
+      REQUIRE(parser.finish());
+
+      Expression ast;
+      REQUIRE(parser.next(ast));
+      bool same = (ast == expected);
+      REQUIRE(same);
+    }
+  }
+
+  {
+    INFO("an invalid atom in a run fails the parse");
+    std::string bad = program;
+    bad.insert(bad.find(" 100.000000") + 11, "x");
+    std::istringstream bad_in(bad);
+    SourceBuffer bad_source(bad_in);
+    REQUIRE(parse(bad_source, 4) == Expression());
+  }
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -11,6 +12,7 @@
 #include "startup_config.hpp"
 #include "consumer.hpp"
 #include "expression.hpp"
+#include "parse.hpp"
 
 using std::endl;
 using std::cout;
@@ -89,6 +91,10 @@ void prompt(){
   std::cout << "\nplotscript> ";
 }
 
+void continuation_prompt(){
+  std::cout << "... ";
+}
+
 std::string readline(){
   std::string line;
   std::getline(std::cin, line);
@@ -109,18 +115,38 @@ void info(const std::string & err_str){
   std::cout << "Info: " << err_str << std::endl;
 }
 
-int eval_from_stream(std::istream & stream){
+int eval_from_source(const SourceBuffer & source, unsigned threads = 1){
+
+  // a program is parsed a block at a time and each expression evaluated as
+  // soon as it is complete, so a mapped file is read while it is evaluated.
+  // Blocks are large enough for the atoms of a large list literal to be
+  // made in parallel on threads threads.
+  const std::size_t BLOCK_SIZE = 1 << 20;
 
   Interpreter interp;
+  StreamParser parser(threads);
+  Expression result;
+  bool evaluated = false;
+
+  std::size_t offset = 0;
+  bool valid = true;
+  bool done = false;
+  while(valid && !done){
+    if(offset < source.size()){
+      std::size_t size = std::min(BLOCK_SIZE, source.size() - offset);
+      valid = parser.feed(source.data() + offset, size);
+      offset += size;
+    }
+    else{
+      valid = parser.finish();
+      done = true;
+    }
 
-  if(!interp.parseStream(stream)){
-    error("Invalid Program. Could not parse.");
-    return EXIT_FAILURE;
-  }
-  else{
     try{
-      Expression exp = interp.evaluate();
-      std::cout << exp << std::endl;
+      while(interp.parseNext(parser)){
+        result = interp.evaluate();
+        evaluated = true;
+      }
     }
     catch(const SemanticError & ex){
       std::cerr << ex.what() << std::endl;
@@ -128,19 +154,38 @@ int eval_from_stream(std::istream & stream){
     }
   }
 
+  if(!valid || !evaluated){
+    error("Invalid Program. Could not parse.");
+    return EXIT_FAILURE;
+  }
+
+  std::cout << result << std::endl;
+
   return EXIT_SUCCESS;
 }
 
+int eval_from_stream(std::istream & stream){
+
+  SourceBuffer source(stream);
+
+  return eval_from_source(source);
+}
+
 int eval_from_file(std::string filename){
 
-  std::ifstream ifs(filename);
+  // the file is mapped into memory and tokenized in place
+  SourceBuffer source;
 
-  if(!ifs){
+  if(!source.open(filename)){
     error("Could not open file for reading.");
     return EXIT_FAILURE;
   }
 
-  return eval_from_stream(ifs);
+  // a file may hold a large data set, whose atoms are made on all hardware
+  // threads when there is more than one; on a single core the parallel
+  // path only adds overhead
+  unsigned cores = std::thread::hardware_concurrency();
+  return eval_from_source(source, (cores > 1) ? cores : 1);
 }
 
 int eval_from_command(std::string argexp){
@@ -163,10 +208,20 @@ void repl(Mq1 & inq, Mq2 &outq, std::thread & interpreter){
   bool execute = true;
   bool prevStop = false;
 
+  // an expression may span lines, the lines are sent to the kernel once the
+  // scanner has seen it end
+  FormScanner scanner;
+  std::string input;
+
   while(!std::cin.eof()){
     global_status_flag = 0;
 
-    prompt();
+    if(input.empty()){
+      prompt();
+    }
+    else{
+      continuation_prompt();
+    }
     std::string line = readline();
 
     if(line.empty()) continue;
@@ -179,7 +234,7 @@ void repl(Mq1 & inq, Mq2 &outq, std::thread & interpreter){
       break;
     }
 
-    if (line == "%start")
+    if (input.empty() && line == "%start")
     {
       if (!interpreter.joinable())
       {
@@ -188,7 +243,7 @@ void repl(Mq1 & inq, Mq2 &outq, std::thread & interpreter){
       execute = false;
     }
 
-    if (line == "%stop")
+    if (input.empty() && line == "%stop")
     {
       if (interpreter.joinable())
       {
@@ -199,7 +254,7 @@ void repl(Mq1 & inq, Mq2 &outq, std::thread & interpreter){
       execute = false;
     }
 
-    if (line == "%reset")
+    if (input.empty() && line == "%reset")
     {
       if (interpreter.joinable())
       {
@@ -214,7 +269,7 @@ void repl(Mq1 & inq, Mq2 &outq, std::thread & interpreter){
       execute = false;
     }
 
-    if (line == "%exit")
+    if (input.empty() && line == "%exit")
     {
       inq.push("");
       break;
@@ -222,7 +277,17 @@ void repl(Mq1 & inq, Mq2 &outq, std::thread & interpreter){
 
     if (execute && !prevStop)
     {
-      inq.push(line);
+      input += line;
+      input += '\n';
+      scanner.scan(input);
+      if (scanner.incomplete() && !scanner.invalid())
+      {
+        continue;
+      }
+      scanner = FormScanner();
+
+      inq.push(input);
+      input.clear();
 
       //waiting for queue B
       std::pair<Expression,std::string> result;
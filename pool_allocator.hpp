@@ -0,0 +1,153 @@
+/*! \file pool_allocator.hpp
+Defines the BlockPool of fixed size memory blocks and the PoolAllocator that
+draws from it.
+ */
+#ifndef POOL_ALLOCATOR_HPP
+#define POOL_ALLOCATOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+/// the smallest power of two, at least a page, that holds bytes bytes
+constexpr std::size_t pool_chunk_bytes(std::size_t bytes, std::size_t size = 4096)
+{
+  return size >= bytes ? size : pool_chunk_bytes(bytes, 2 * size);
+}
+
+/*! \class BlockPool
+\brief Thread-local free lists of memory blocks of one size.
+
+Blocks are carved from large chunks and recycled through a free list private
+to each thread, so allocating and freeing a block is a pointer swap that
+takes no lock and does not touch the global heap. Each chunk records the
+thread that carved it. A block freed on a different thread is pushed onto a
+lock-free list of its owner, which the owner takes back before it carves
+another chunk, so memory built on one thread and released on another is
+reused rather than grown. The chunks and free blocks of a thread that exits
+are handed whole to the next thread that runs out. Chunks are never returned
+to the heap.
+*/
+template<std::size_t Size>
+class BlockPool
+{
+public:
+
+  /// return a block of Size bytes, aligned for any scalar type
+  static void * allocate();
+
+  /// return a block obtained from allocate to the pool
+  static void deallocate(void * block) noexcept;
+
+private:
+
+  union Block {
+    Block * next;
+    alignas(std::max_align_t) unsigned char storage[Size];
+  };
+
+  // the chunks and blocks of one thread, handed on when the thread exits
+  struct Owner {
+    // blocks freed by other threads, pushed without a lock
+    std::atomic<Block *> remote;
+    // the free list left by the exited thread that last owned the chunks
+    Block * stash = nullptr;
+    // the next orphaned owner
+    Owner * next = nullptr;
+
+    Owner() : remote(nullptr) {}
+  };
+
+  // the header kept in the first block of each chunk
+  struct Chunk {
+    Owner * owner;
+  };
+
+  static_assert(sizeof(Chunk) <= sizeof(Block), "a chunk header must fit in a block");
+
+  static const std::size_t BLOCKS_PER_CHUNK = 1024;
+
+  // chunks are aligned to their size, so a block finds its chunk by masking
+  static const std::size_t CHUNK_BYTES = pool_chunk_bytes(BLOCKS_PER_CHUNK * sizeof(Block));
+
+  // the free list and owner of this thread. They are trivially destructible,
+  // so they stay usable while other thread-local objects are destroyed at
+  // thread exit.
+  static thread_local Block * head;
+  static thread_local Owner * self;
+
+  // on thread exit, hands the owner of the thread to orphans
+  struct Reaper {
+    ~Reaper();
+  };
+
+  // owners left by exited threads, guarded by a mutex
+  struct Orphans {
+    std::mutex mutex;
+    Owner * head = nullptr;
+  };
+
+  static Orphans & orphans();
+
+  // take an orphaned or new owner for this thread, returning its stash
+  static Block * adopt();
+
+  static Block * refill();
+};
+
+/*! Allocate a block of at least bytes bytes from the BlockPool of the
+  smallest power of two size class, from 16 to MAX_POOLED_ARRAY bytes, that
+  holds it.
+ */
+inline void * pool_allocate(std::size_t bytes);
+
+/// return a block from pool_allocate, given the same bytes
+inline void pool_deallocate(void * block, std::size_t bytes) noexcept;
+
+/// the largest array served from the size class pools
+const std::size_t MAX_POOLED_ARRAY = 1024;
+
+/*! \class PoolAllocator
+\brief A standard allocator that serves objects and small arrays from
+BlockPools.
+
+Single objects up to MAX_SIZE bytes come from a pool of their own size.
+Arrays up to MAX_POOLED_ARRAY bytes come from the power of two size class
+pools. Anything larger is passed to the global operator new. All instances
+are interchangeable.
+*/
+template<typename T>
+class PoolAllocator
+{
+public:
+
+  typedef T value_type;
+
+  /// the largest object served from a pool
+  static const std::size_t MAX_SIZE = 128;
+
+  PoolAllocator() noexcept {}
+
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+  T * allocate(std::size_t n);
+
+  void deallocate(T * p, std::size_t n) noexcept;
+
+private:
+
+  // objects are served from the pool for their size rounded up to 16 bytes
+  typedef BlockPool<(sizeof(T) + 15) / 16 * 16> Pool;
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept { return true; }
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept { return false; }
+
+#include "pool_allocator.tpp"
+
+#endif
@@ -0,0 +1,177 @@
+#include "pool_allocator.hpp"
+
+template<std::size_t Size>
+thread_local typename BlockPool<Size>::Block * BlockPool<Size>::head = nullptr;
+
+template<std::size_t Size>
+thread_local typename BlockPool<Size>::Owner * BlockPool<Size>::self = nullptr;
+
+template<std::size_t Size>
+typename BlockPool<Size>::Orphans & BlockPool<Size>::orphans()
+{
+  // used by threads exiting during program shutdown, so never destroyed
+  static Orphans * shared = new Orphans();
+  return *shared;
+}
+
+template<std::size_t Size>
+BlockPool<Size>::Reaper::~Reaper()
+{
+  // blocks freed on this thread from now on are pushed as remote frees
+  Owner * owner = self;
+  self = nullptr;
+
+  owner->stash = head;
+  head = nullptr;
+
+  Orphans & o = orphans();
+  std::lock_guard<std::mutex> lock(o.mutex);
+  owner->next = o.head;
+  o.head = owner;
+}
+
+template<std::size_t Size>
+typename BlockPool<Size>::Block * BlockPool<Size>::adopt()
+{
+  // the first use constructs the reaper, registering it for thread exit
+  static thread_local Reaper reaper;
+  (void)reaper;
+
+  {
+    Orphans & o = orphans();
+    std::lock_guard<std::mutex> lock(o.mutex);
+    self = o.head;
+    if (self != nullptr)
+    {
+      o.head = self->next;
+    }
+  }
+
+  if (self == nullptr)
+  {
+    self = new Owner();
+  }
+
+  Block * stash = self->stash;
+  self->stash = nullptr;
+  return stash;
+}
+
+template<std::size_t Size>
+typename BlockPool<Size>::Block * BlockPool<Size>::refill()
+{
+  if (self == nullptr)
+  {
+    Block * stash = adopt();
+    if (stash != nullptr)
+    {
+      return stash;
+    }
+  }
+
+  Block * freed = self->remote.exchange(nullptr, std::memory_order_acquire);
+  if (freed != nullptr)
+  {
+    return freed;
+  }
+
+  // over-allocate so that a chunk aligned to its size fits inside; the pages
+  // of the unused ends are never touched
+  std::size_t raw = reinterpret_cast<std::size_t>(::operator new(2 * CHUNK_BYTES));
+  Block * chunk = reinterpret_cast<Block *>((raw + CHUNK_BYTES - 1) & ~(CHUNK_BYTES - 1));
+  reinterpret_cast<Chunk *>(chunk)->owner = self;
+
+  const std::size_t blocks = CHUNK_BYTES / sizeof(Block);
+  for (std::size_t i = 1; i + 1 < blocks; ++i)
+  {
+    chunk[i].next = &chunk[i + 1];
+  }
+  chunk[blocks - 1].next = nullptr;
+  return &chunk[1];
+}
+
+template<std::size_t Size>
+void * BlockPool<Size>::allocate()
+{
+  if (head == nullptr)
+  {
+    head = refill();
+  }
+
+  Block * block = head;
+  head = block->next;
+  return block;
+}
+
+template<std::size_t Size>
+void BlockPool<Size>::deallocate(void * block) noexcept
+{
+  Block * b = static_cast<Block *>(block);
+  std::size_t address = reinterpret_cast<std::size_t>(block);
+  Owner * owner = reinterpret_cast<Chunk *>(address & ~(CHUNK_BYTES - 1))->owner;
+
+  if (owner == self)
+  {
+    b->next = head;
+    head = b;
+    return;
+  }
+
+  Block * top = owner->remote.load(std::memory_order_relaxed);
+  do {
+    b->next = top;
+  } while (!owner->remote.compare_exchange_weak(top, b, std::memory_order_release,
+                                                std::memory_order_relaxed));
+}
+
+void * pool_allocate(std::size_t bytes)
+{
+  if (bytes <= 16) return BlockPool<16>::allocate();
+  if (bytes <= 32) return BlockPool<32>::allocate();
+  if (bytes <= 64) return BlockPool<64>::allocate();
+  if (bytes <= 128) return BlockPool<128>::allocate();
+  if (bytes <= 256) return BlockPool<256>::allocate();
+  if (bytes <= 512) return BlockPool<512>::allocate();
+  return BlockPool<1024>::allocate();
+}
+
+void pool_deallocate(void * block, std::size_t bytes) noexcept
+{
+  if (bytes <= 16) return BlockPool<16>::deallocate(block);
+  if (bytes <= 32) return BlockPool<32>::deallocate(block);
+  if (bytes <= 64) return BlockPool<64>::deallocate(block);
+  if (bytes <= 128) return BlockPool<128>::deallocate(block);
+  if (bytes <= 256) return BlockPool<256>::deallocate(block);
+  if (bytes <= 512) return BlockPool<512>::deallocate(block);
+  return BlockPool<1024>::deallocate(block);
+}
+
+template<typename T>
+T * PoolAllocator<T>::allocate(std::size_t n)
+{
+  if (n == 1 && sizeof(T) <= MAX_SIZE)
+  {
+    return static_cast<T *>(Pool::allocate());
+  }
+  if (n * sizeof(T) <= MAX_POOLED_ARRAY)
+  {
+    return static_cast<T *>(pool_allocate(n * sizeof(T)));
+  }
+  return static_cast<T *>(::operator new(n * sizeof(T)));
+}
+
+template<typename T>
+void PoolAllocator<T>::deallocate(T * p, std::size_t n) noexcept
+{
+  if (n == 1 && sizeof(T) <= MAX_SIZE)
+  {
+    Pool::deallocate(p);
+    return;
+  }
+  if (n * sizeof(T) <= MAX_POOLED_ARRAY)
+  {
+    pool_deallocate(p, n * sizeof(T));
+    return;
+  }
+  ::operator delete(p);
+}
@@ -0,0 +1,125 @@
+#include "catch.hpp"
+
+#include "pool_allocator.hpp"
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+TEST_CASE( "Test pool blocks are recycled", "[pool_allocator]" ) {
+
+  void * a = BlockPool<32>::allocate();
+  void * b = BlockPool<32>::allocate();
+
+  REQUIRE(a != b);
+
+  BlockPool<32>::deallocate(a);
+  REQUIRE(BlockPool<32>::allocate() == a);
+
+  BlockPool<32>::deallocate(a);
+  BlockPool<32>::deallocate(b);
+}
+
+TEST_CASE( "Test pool allocator with standard containers", "[pool_allocator]" ) {
+
+  std::map<int, double, std::less<int>, PoolAllocator<std::pair<const int, double>>> m;
+  for(int i = 0; i < 5000; ++i){
+    m.emplace(i, i * 0.5);
+  }
+  REQUIRE(m.size() == 5000);
+  REQUIRE(m.at(4000) == 2000.0);
+
+  std::shared_ptr<std::vector<int>> v = std::allocate_shared<std::vector<int>>(PoolAllocator<std::vector<int>>(), 3, 7);
+  REQUIRE(v->size() == 3);
+  REQUIRE(v->at(2) == 7);
+
+  // small arrays come from the size class pools, large ones from the heap
+  PoolAllocator<int> alloc;
+  int * small = alloc.allocate(100);
+  small[99] = 1;
+  alloc.deallocate(small, 100);
+  REQUIRE(alloc.allocate(100) == small);
+  alloc.deallocate(small, 100);
+
+  int * large = alloc.allocate(1000);
+  large[999] = 1;
+  alloc.deallocate(large, 1000);
+}
+
+TEST_CASE( "Test pool blocks of an exited thread", "[pool_allocator]" ) {
+
+  std::vector<void *> blocks;
+  std::thread other([&blocks](){
+    for(int i = 0; i < 2000; ++i){
+      blocks.push_back(BlockPool<64>::allocate());
+    }
+    for(void * b : blocks){
+      BlockPool<64>::deallocate(b);
+    }
+  });
+  other.join();
+
+  // the blocks left by the exited thread are reused by the next thread that
+  // needs blocks
+  bool found = false;
+  std::thread next([&blocks, &found](){
+    void * reused = BlockPool<64>::allocate();
+    for(void * b : blocks){
+      found = found || (b == reused);
+    }
+    BlockPool<64>::deallocate(reused);
+  });
+  next.join();
+
+  REQUIRE(found);
+}
+
+TEST_CASE( "Test pool blocks freed on another thread", "[pool_allocator]" ) {
+
+  // blocks are built on this thread and released on a thread that keeps
+  // running, as results are by the kernel and the thread showing them
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<void *> handed;
+  bool done = false;
+
+  std::thread other([&](){
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!done){
+      for(void * b : handed){
+        BlockPool<208>::deallocate(b);
+      }
+      handed.clear();
+      cv.notify_all();
+      cv.wait(lock);
+    }
+  });
+
+  std::set<void *> seen;
+  for(int round = 0; round < 20; ++round){
+    std::vector<void *> blocks;
+    for(int i = 0; i < 2000; ++i){
+      blocks.push_back(BlockPool<208>::allocate());
+      seen.insert(blocks.back());
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    handed.swap(blocks);
+    cv.notify_all();
+    cv.wait(lock, [&handed](){ return handed.empty(); });
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    cv.notify_all();
+  }
+  other.join();
+
+  // the freed blocks go back to this thread instead of new chunks
+  REQUIRE(seen.size() < 4000);
+}
@@ -0,0 +1,52 @@
+#include "symbol_table.hpp"
+
+#include <stdexcept>
+
+SymbolTable::SymbolTable(): next(0){
+  for(auto & c : chunks){
+    c.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+SymbolTable & SymbolTable::instance(){
+  // chunks live for the whole program, so the table is never destroyed
+  static SymbolTable * table = new SymbolTable();
+  return *table;
+}
+
+SymbolTable::IdType SymbolTable::intern(const std::string & name){
+
+  SymbolTable & table = instance();
+  std::lock_guard<std::mutex> lock(table.mutex);
+
+  auto result = table.ids.find(name);
+  if(result != table.ids.end()){
+    return result->second;
+  }
+
+  IdType id = table.next;
+  std::size_t chunk = id >> CHUNK_BITS;
+  if(chunk >= MAX_CHUNKS){
+    throw std::length_error("Symbol table is full");
+  }
+
+  std::string * storage = table.chunks[chunk].load(std::memory_order_relaxed);
+  if(storage == nullptr){
+    storage = new std::string[CHUNK_SIZE];
+  }
+  storage[id & (CHUNK_SIZE - 1)] = name;
+
+  // publish the chunk after the name is written
+  table.chunks[chunk].store(storage, std::memory_order_release);
+
+  table.ids.emplace(name, id);
+  ++table.next;
+
+  return id;
+}
+
+const std::string & SymbolTable::name(IdType id) noexcept{
+
+  std::string * storage = instance().chunks[id >> CHUNK_BITS].load(std::memory_order_acquire);
+  return storage[id & (CHUNK_SIZE - 1)];
+}
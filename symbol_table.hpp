@@ -0,0 +1,59 @@
+/*! \file symbol_table.hpp
+Defines the SymbolTable used to intern symbol names.
+ */
+#ifndef SYMBOL_TABLE_HPP
+#define SYMBOL_TABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*! \class SymbolTable
+\brief A process-wide table of interned symbol names.
+
+Each distinct name is stored exactly once and identified by a compact
+integer id, so symbols can be copied and compared without touching the
+string. Interning is thread-safe; looking up the name of an existing id
+does not take a lock.
+*/
+class SymbolTable {
+public:
+
+  /// the type used to identify an interned symbol
+  typedef std::uint32_t IdType;
+
+  /*! Intern a symbol name
+    \param name the name to intern
+    \return the id of name, the same for every call with an equal name
+  */
+  static IdType intern(const std::string & name);
+
+  /*! Get the name of an interned symbol
+    \param id an id previously returned by intern
+    \return a reference to the stored name, valid for the life of the program
+  */
+  static const std::string & name(IdType id) noexcept;
+
+private:
+
+  SymbolTable();
+
+  static SymbolTable & instance();
+
+  // names are stored in fixed size chunks so that existing names never move
+  // and readers do not need to synchronize with writers
+  static const std::size_t CHUNK_BITS = 12;
+  static const std::size_t CHUNK_SIZE = std::size_t(1) << CHUNK_BITS;
+  static const std::size_t MAX_CHUNKS = 4096;
+
+  std::atomic<std::string *> chunks[MAX_CHUNKS];
+
+  // map from name to id and the next free id, guarded by mutex
+  std::unordered_map<std::string, IdType> ids;
+  IdType next;
+  std::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "catch.hpp"
+
+#include "symbol_table.hpp"
+#include "atom.hpp"
+
+#include <thread>
+#include <vector>
+
+TEST_CASE( "Test interning names", "[symbol_table]" ) {
+
+  SymbolTable::IdType a = SymbolTable::intern("interned-a");
+  SymbolTable::IdType b = SymbolTable::intern("interned-b");
+
+  REQUIRE(a != b);
+  REQUIRE(SymbolTable::intern("interned-a") == a);
+  REQUIRE(SymbolTable::name(a) == "interned-a");
+  REQUIRE(SymbolTable::name(b) == "interned-b");
+}
+
+TEST_CASE( "Test symbol atoms share interned ids", "[symbol_table]" ) {
+
+  Atom a("shared");
+  Atom b(std::string("shared"));
+  Atom c = a;
+
+  REQUIRE(a.symbolId() == b.symbolId());
+  REQUIRE(c.symbolId() == a.symbolId());
+  REQUIRE(c.asSymbol() == "shared");
+  REQUIRE(a == b);
+  REQUIRE(a != Atom("not-shared"));
+}
+
+TEST_CASE( "Test interning from several threads", "[symbol_table]" ) {
+
+  std::vector<SymbolTable::IdType> ids(4);
+  std::vector<std::thread> threads;
+
+  for(std::size_t i = 0; i < ids.size(); ++i){
+    threads.emplace_back([&ids, i](){
+      for(int j = 0; j < 1000; ++j){
+        SymbolTable::intern("thread-sym-" + std::to_string(j));
+      }
+      ids[i] = SymbolTable::intern("thread-common");
+    });
+  }
+  for(auto & t : threads){
+    t.join();
+  }
+
+  for(auto id : ids){
+    REQUIRE(id == ids[0]);
+  }
+  REQUIRE(SymbolTable::name(ids[0]) == "thread-common");
+  REQUIRE(SymbolTable::name(SymbolTable::intern("thread-sym-999")) == "thread-sym-999");
+}
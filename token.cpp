@@ -2,7 +2,17 @@
 
 // system includes
 #include <cctype>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#define MAP_SOURCE_FILES
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using std::endl;
 using std::cout;
@@ -34,60 +44,219 @@ std::string Token::asString() const{
 }
 
 
-// add token to sequence unless it is empty, clears token
-void store_ifnot_empty(std::string & token, TokenSequenceType & seq){
-  if(!token.empty()){
-    seq.emplace_back(token);
-    token.clear();
+TokenView::TokenView() noexcept: m_offset(0), m_length(0), m_type(Token::OPEN){}
+
+TokenView::TokenView(Token::TokenType t, std::size_t offset, std::size_t length) noexcept:
+  m_offset(offset), m_length(static_cast<std::uint32_t>(length)), m_type(t){}
+
+Token::TokenType TokenView::type() const noexcept{
+  return m_type;
+}
+
+std::size_t TokenView::offset() const noexcept{
+  return m_offset;
+}
+
+std::size_t TokenView::length() const noexcept{
+  return m_length;
+}
+
+SourceBuffer::SourceBuffer() noexcept: first(nullptr), count(0), mapping(nullptr){}
+
+SourceBuffer::SourceBuffer(std::istream & in): SourceBuffer(){
+
+  std::ostringstream contents;
+  if(in.peek() != std::char_traits<char>::eof()){
+    contents << in.rdbuf();
   }
+  storage = contents.str();
+  first = storage.data();
+  count = storage.size();
 }
 
-TokenSequenceType tokenize(std::istream & seq){
-  TokenSequenceType tokens;
-  std::string token;
+SourceBuffer::~SourceBuffer(){
+  release();
+}
 
-  while(true){
-    char c = seq.get();
-    if(seq.eof()) break;
+void SourceBuffer::release() noexcept{
 
-    if(c == COMMENTCHAR){
-      // chomp until the end of the line
-      while((!seq.eof()) && (c != '\n')){
-	       c = seq.get();
-      }
-      if(seq.eof()) break;
+#ifdef MAP_SOURCE_FILES
+  if(mapping != nullptr){
+    munmap(mapping, count);
+  }
+#endif
+  mapping = nullptr;
+  storage.clear();
+  first = storage.data();
+  count = 0;
+}
+
+bool SourceBuffer::open(const std::string & filename){
+
+  release();
+
+#ifdef MAP_SOURCE_FILES
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0){
+    return false;
+  }
+
+  // only a non-empty regular file can be mapped, anything else is read
+  struct stat status;
+  if((fstat(fd, &status) == 0) && S_ISREG(status.st_mode) && (status.st_size > 0)){
+    void * region = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(region != MAP_FAILED){
+      mapping = region;
+      first = static_cast<const char *>(region);
+      count = status.st_size;
     }
-    else if(c == OPENCHAR){
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::OPEN);
+  }
+  close(fd);
+
+  if(mapping != nullptr){
+    return true;
+  }
+#endif
+
+  std::ifstream in(filename, std::ios::binary);
+  if(!in){
+    return false;
+  }
+
+  std::ostringstream contents;
+  if(in.peek() != std::char_traits<char>::eof()){
+    contents << in.rdbuf();
+  }
+  storage = contents.str();
+  first = storage.data();
+  count = storage.size();
+  return true;
+}
+
+const char * SourceBuffer::data() const noexcept{
+  return first;
+}
+
+std::size_t SourceBuffer::size() const noexcept{
+  return count;
+}
+
+std::string SourceBuffer::text(const TokenView & token) const{
+
+  switch(token.type()){
+  case Token::OPEN:
+    return "(";
+  case Token::CLOSE:
+    return ")";
+  default:
+    return std::string(first + token.offset(), token.length());
+  }
+}
+
+// predicate, c is white space in the "C" locale
+static bool is_space(char c) noexcept{
+  return (c == ' ') || (c == '\n') || (c == '\t') || (c == '\r') || (c == '\v') || (c == '\f');
+}
+
+Tokenizer::Tokenizer(const char * first, std::size_t size) noexcept: first(first), size(size), position(0){}
+
+bool Tokenizer::next(TokenView & token) noexcept{
+
+  while(position < size){
+    char c = first[position];
+
+    if(c == OPENCHAR){
+      token = TokenView(Token::OPEN, position++, 1);
+      return true;
     }
     else if(c == CLOSECHAR){
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::CLOSE);
+      token = TokenView(Token::CLOSE, position++, 1);
+      return true;
     }
-    else if (c == QUOTECHAR)
-    {
-      token.push_back(c);
-
-      c = seq.get();
-      while (!seq.eof() && c != '"')
-      {
-        token.push_back(c);
-        c = seq.get();
+    else if(c == COMMENTCHAR){
+      // chomp until the end of the line
+      while((position < size) && (first[position] != '\n')){
+        ++position;
+      }
+    }
+    else if(is_space(c)){
+      ++position;
+    }
+    else{
+      // a string runs to the next delimiter, or to the end of a quotation
+      std::size_t start = position;
+      while(position < size){
+        c = first[position];
+        if(c == QUOTECHAR){
+          ++position;
+          while((position < size) && (first[position] != QUOTECHAR)){
+            ++position;
+          }
+          if(position < size){
+            ++position;
+          }
+          break;
+        }
+        if((c == OPENCHAR) || (c == CLOSECHAR) || (c == COMMENTCHAR) || is_space(c)){
+          break;
+        }
+        ++position;
       }
+      token = TokenView(Token::STRING, start, position - start);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Tokenizer::seek(std::size_t p) noexcept{
+  position = p;
+}
+
+std::size_t Tokenizer::next_space(std::size_t p) const noexcept{
+
+  while((p < size) && !is_space(first[p])){
+    ++p;
+  }
+  return p;
+}
 
-      token.push_back(c);//add the quote since it was the last one seen
+std::size_t Tokenizer::next_delimiter(std::size_t p) const noexcept{
 
-      store_ifnot_empty(token, tokens);
+  while(p < size){
+    char c = first[p];
+    if((c == OPENCHAR) || (c == CLOSECHAR) || (c == COMMENTCHAR) || (c == QUOTECHAR)){
+      break;
     }
-    else if(isspace(c)){
-      store_ifnot_empty(token, tokens);
+    ++p;
+  }
+  return p;
+}
+
+TokenViewSequenceType tokenize(const SourceBuffer & source){
+
+  TokenViewSequenceType tokens;
+  Tokenizer tokenizer(source.data(), source.size());
+
+  TokenView token;
+  while(tokenizer.next(token)){
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+TokenSequenceType tokenize(std::istream & seq){
+
+  SourceBuffer source(seq);
+  TokenSequenceType tokens;
+
+  for(const TokenView & token : tokenize(source)){
+    if(token.type() == Token::STRING){
+      tokens.emplace_back(source.text(token));
     }
     else{
-      token.push_back(c);
+      tokens.emplace_back(token.type());
     }
   }
-  store_ifnot_empty(token, tokens);
-
   return tokens;
 }
@@ -4,8 +4,11 @@ Defines the Token and TokenSequence types, and associated functions.
 #ifndef TOKEN_HPP
 #define TOKEN_HPP
 
+#include <cstdint>
 #include <deque>
 #include <istream>
+#include <string>
+#include <vector>
 
 /*! \class Token
   \brief Value class representing a token.
@@ -47,6 +50,140 @@ sequential access should do.
  */
 typedef std::deque<Token> TokenSequenceType;
 
+/*! \class TokenView
+  \brief A token referring to its characters in a SourceBuffer.
+
+  The characters of a STRING token are given by their offset and length in
+  the buffer, so making a token never copies them.
+*/
+class TokenView {
+public:
+
+  /// construct an OPEN token at the start of the buffer
+  TokenView() noexcept;
+
+  /// construct a token of type t spanning length characters from offset
+  TokenView(Token::TokenType t, std::size_t offset, std::size_t length) noexcept;
+
+  /// return the type of the token
+  Token::TokenType type() const noexcept;
+
+  /// return the offset of the first character of the token
+  std::size_t offset() const noexcept;
+
+  /// return the number of characters in the token
+  std::size_t length() const noexcept;
+
+private:
+  std::size_t m_offset;
+  std::uint32_t m_length;
+  Token::TokenType m_type;
+};
+
+/*! \class SourceBuffer
+  \brief The characters of a program held in one contiguous block of memory.
+
+  A file is memory-mapped where the platform allows it, and read into the
+  buffer otherwise. A stream is read into the buffer.
+*/
+class SourceBuffer {
+public:
+
+  /// construct an empty buffer
+  SourceBuffer() noexcept;
+
+  /// construct a buffer holding the remaining characters of a stream
+  explicit SourceBuffer(std::istream & in);
+
+  SourceBuffer(const SourceBuffer &) = delete;
+  SourceBuffer & operator=(const SourceBuffer &) = delete;
+
+  ~SourceBuffer();
+
+  /*! Replace the contents with those of a file.
+    \param filename the name of the file
+    \return true on success, false if the file could not be opened
+   */
+  bool open(const std::string & filename);
+
+  /// return a pointer to the first character
+  const char * data() const noexcept;
+
+  /// return the number of characters
+  std::size_t size() const noexcept;
+
+  /// return the characters of a token as a string
+  std::string text(const TokenView & token) const;
+
+private:
+
+  // release a mapping, if any, and empty the buffer
+  void release() noexcept;
+
+  const char * first;
+  std::size_t count;
+
+  // the characters, unless they are mapped
+  std::string storage;
+
+  // the mapped region of a file, or nullptr
+  void * mapping;
+};
+
+/*! \class Tokenizer
+  \brief Splits a block of characters into tokens one at a time.
+
+  The rules are those of tokenize, except that a comment always ends the
+  token before it. Scanning does not allocate, and the tokens refer to
+  the characters by their offset from the start of the block.
+*/
+class Tokenizer {
+public:
+
+  /// construct a tokenizer over size characters from first
+  Tokenizer(const char * first, std::size_t size) noexcept;
+
+  /*! Scan the next token.
+    \param token set to the next token
+    \return true if there was one, false at the end of the characters
+   */
+  bool next(TokenView & token) noexcept;
+
+  /// continue scanning from position, which must not be inside a token
+  void seek(std::size_t position) noexcept;
+
+  /*! Find the next white space character.
+    \return the position of the first one at or after position, or the
+    number of characters if there is none
+   */
+  std::size_t next_space(std::size_t position) const noexcept;
+
+  /*! Find the next parenthesis, quotation mark or comment character, so
+    that only STRING tokens without quotations lie between position and it.
+    \return the position of the first one at or after position, or the
+    number of characters if there is none
+   */
+  std::size_t next_delimiter(std::size_t position) const noexcept;
+
+private:
+  const char * first;
+  std::size_t size;
+  std::size_t position;
+};
+
+/*! \typedef TokenViewSequenceType
+Define the sequence of TokenViews made from a SourceBuffer.
+ */
+typedef std::vector<TokenView> TokenViewSequenceType;
+
+/*! \fn TokenViewSequenceType tokenize(const SourceBuffer & source)
+\brief Split the characters of a buffer into a sequence of tokens
+
+\param source the characters
+\return The sequence of tokens, referring to the characters of source
+*/
+TokenViewSequenceType tokenize(const SourceBuffer & source);
+
 /*! \fn TokenSequenceType tokenize(std::istream & seq)
 \brief Split a stream into a sequnce of tokens
 
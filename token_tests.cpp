@@ -1,5 +1,9 @@
 #include "catch.hpp"
 
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 #include "token.hpp"
 
 TEST_CASE( "Test Token creation", "[token]" ) {
@@ -73,3 +77,66 @@ TEST_CASE( "Test tokenize", "[token]" ) {
   REQUIRE(tokens.empty());
 }
 
+
+TEST_CASE( "Test tokenize a buffer into views", "[token]" ) {
+  std::string input = "(define s \"a (quoted) string\") ;(not a token\n(f 1.5)abc";
+
+  std::istringstream iss(input);
+  SourceBuffer source(iss);
+
+  REQUIRE(source.size() == input.size());
+
+  TokenViewSequenceType tokens = tokenize(source);
+
+  std::vector<std::string> expected = {"(", "define", "s", "\"a (quoted) string\"", ")",
+                                       "(", "f", "1.5", ")", "abc"};
+  REQUIRE(tokens.size() == expected.size());
+  for(std::size_t i = 0; i < tokens.size(); ++i){
+    REQUIRE(source.text(tokens[i]) == expected[i]);
+  }
+
+  // the views refer to the characters of the buffer
+  REQUIRE(tokens[1].type() == Token::STRING);
+  REQUIRE(tokens[1].offset() == 1);
+  REQUIRE(tokens[1].length() == 6);
+  REQUIRE(tokens[4].type() == Token::CLOSE);
+}
+
+TEST_CASE( "Test read a buffer from a file", "[token]" ) {
+
+  const char * filename = "token_tests_source.pls";
+  {
+    std::ofstream out(filename);
+    out << "(+ 1 2)\n";
+  }
+
+  SourceBuffer source;
+  REQUIRE(source.open(filename));
+  REQUIRE(std::string(source.data(), source.size()) == "(+ 1 2)\n");
+  REQUIRE(tokenize(source).size() == 5);
+
+  std::remove(filename);
+
+  REQUIRE(!source.open(filename));
+  REQUIRE(source.size() == 0);
+}
+
+TEST_CASE( "Test finding runs of atoms", "[token]" ) {
+
+  std::string text = "1 22 abc\t4 \"q\" (x)";
+  Tokenizer tokenizer(text.data(), text.size());
+
+  REQUIRE(tokenizer.next_space(0) == 1);
+  REQUIRE(tokenizer.next_space(3) == 4);
+  REQUIRE(tokenizer.next_space(15) == text.size());
+  REQUIRE(tokenizer.next_delimiter(0) == 11);
+  REQUIRE(tokenizer.next_delimiter(12) == 13);
+  REQUIRE(tokenizer.next_delimiter(14) == 15);
+
+  // scanning continues at a position between tokens
+  tokenizer.seek(8);
+  TokenView token;
+  REQUIRE(tokenizer.next(token));
+  REQUIRE(token.offset() == 9);
+  REQUIRE(token.length() == 1);
+}